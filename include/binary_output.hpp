@@ -0,0 +1,138 @@
+#ifndef BINARY_OUTPUT_HPP
+#define BINARY_OUTPUT_HPP
+
+/**
+ * @file binary_output.hpp
+ * @brief Formato binário compacto para resultados de recomendação em lote.
+ *
+ * Alternativa ao outcome/output.dat textual: sem percentuais arredondados nem títulos,
+ * apenas registros de largura fixa com as notas previstas em precisão total. O arquivo
+ * inteiro pode ser consumido com um único mmap; os títulos só são resolvidos na apresentação.
+ *
+ * Layout (little-endian, tudo alinhado em 4 bytes):
+ *   [BinaryRecommendationsHeader]                                  (header_size bytes)
+ *   record_count x {
+ *       BinaryRecommendationRecordPrefix                           (28 bytes)
+ *       int32_t item_ids[top_n]   (MovieIDs; -1 nas posições não usadas)
+ *       float   scores[top_n]     (notas previstas; 0 nas posições não usadas)
+ *   }                                                              (record_size bytes cada)
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "types.hpp"
+
+constexpr char BINARY_RECOMMENDATIONS_MAGIC[8] = {'L', 'S', 'H', 'R', 'E', 'C', 'S', '\0'};
+constexpr uint32_t BINARY_RECOMMENDATIONS_VERSION = 2;
+
+struct BinaryRecommendationsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t top_n;
+    uint64_t record_count;
+    uint32_t engine;           // Valor de RecommenderEngineType
+    uint32_t k_neighbors;
+    uint32_t num_lsh_tables;
+    uint32_t num_hyperplanes;
+};
+static_assert(sizeof(BinaryRecommendationsHeader) == 48, "Layout do cabeçalho binário mudou");
+
+struct BinaryRecommendationRecordPrefix {
+    int32_t user_id;
+    uint32_t num_items;        // Itens válidos em item_ids/scores (<= top_n)
+    uint32_t num_neighbors;
+    float mean_similarity;
+    float min_similarity;
+    float max_similarity;
+    uint32_t flags;            // BINARY_RECORD_FLAG_*
+};
+static_assert(sizeof(BinaryRecommendationRecordPrefix) == 28, "Layout do registro binário mudou");
+
+// Resultado parcial: o orçamento da consulta acabou antes do fim (ver QueryBudget).
+constexpr uint32_t BINARY_RECORD_FLAG_DEGRADED = 1u << 0;
+
+/**
+ * @brief Tamanho em bytes de um registro para um dado top_n.
+ */
+inline size_t binaryRecommendationRecordSize(int top_n) {
+    return sizeof(BinaryRecommendationRecordPrefix) + static_cast<size_t>(top_n) * (sizeof(int32_t) + sizeof(float));
+}
+
+/**
+ * @brief Monta o cabeçalho com os parâmetros da execução atual.
+ */
+BinaryRecommendationsHeader makeBinaryRecommendationsHeader(uint64_t record_count, int top_n,
+                                                            uint32_t engine, int k_neighbors,
+                                                            int num_lsh_tables, int num_hyperplanes);
+
+/**
+ * @brief Acrescenta o cabeçalho ao buffer.
+ */
+void appendBinaryRecommendationsHeader(std::string& output, const BinaryRecommendationsHeader& header);
+
+/**
+ * @brief Acrescenta ao buffer o registro de largura fixa de um usuário.
+ * @param output Buffer de destino.
+ * @param target_user_id ID do usuário.
+ * @param neighbor_stats Estatísticas das similaridades dos vizinhos usados.
+ * @param recommendations Recomendações ordenadas (apenas as top_n primeiras são gravadas).
+ * @param top_n Número de posições do registro.
+ */
+void appendUserRecommendationsBinary(std::string& output,
+                                     int target_user_id,
+                                     const NeighborSimilarityStats& neighbor_stats,
+                                     const RecommendationList& recommendations,
+                                     int top_n);
+
+/**
+ * @brief Visão somente leitura de um arquivo binário de recomendações, mapeado com mmap.
+ */
+class MappedBinaryRecommendations {
+public:
+    MappedBinaryRecommendations() = default;
+    ~MappedBinaryRecommendations();
+
+    MappedBinaryRecommendations(const MappedBinaryRecommendations&) = delete;
+    MappedBinaryRecommendations& operator=(const MappedBinaryRecommendations&) = delete;
+
+    /**
+     * @brief Mapeia o arquivo e valida cabeçalho e tamanho.
+     * @return true se o arquivo é um arquivo de recomendações válido.
+     */
+    bool open(const std::string& input_path);
+    void close();
+
+    const BinaryRecommendationsHeader& header() const { return *reinterpret_cast<const BinaryRecommendationsHeader*>(data_); }
+    uint64_t recordCount() const { return header().record_count; }
+    int topN() const { return static_cast<int>(header().top_n); }
+
+    const BinaryRecommendationRecordPrefix& record(size_t i) const {
+        return *reinterpret_cast<const BinaryRecommendationRecordPrefix*>(recordBase(i));
+    }
+    const int32_t* itemIds(size_t i) const {
+        return reinterpret_cast<const int32_t*>(recordBase(i) + sizeof(BinaryRecommendationRecordPrefix));
+    }
+    const float* scores(size_t i) const {
+        return reinterpret_cast<const float*>(recordBase(i) + sizeof(BinaryRecommendationRecordPrefix) + header().top_n * sizeof(int32_t));
+    }
+
+private:
+    const char* recordBase(size_t i) const { return data_ + header().header_size + i * header().record_size; }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/**
+ * @brief Converte um registro binário para o formato de texto de outcome/output.dat.
+ * @details É aqui, na apresentação, que os títulos dos filmes são resolvidos.
+ */
+void appendBinaryRecordAsText(std::string& output,
+                              const MappedBinaryRecommendations& mapped,
+                              size_t record_index,
+                              const MovieCatalog& movie_catalog);
+
+#endif // BINARY_OUTPUT_HPP
@@ -0,0 +1,171 @@
+#ifndef COMPRESSED_ROWS_HPP
+#define COMPRESSED_ROWS_HPP
+
+/**
+ * @file compressed_rows.hpp
+ * @brief Linhas da matriz de avaliações e listas dos buckets LSH comprimidas (delta + StreamVByte).
+ *
+ * Em cada linha os índices densos dos filmes são crescentes, então guardamos apenas as diferenças
+ * (deltas) entre índices consecutivos — quase sempre menores que 256. Os deltas são empacotados no
+ * esquema StreamVByte: para cada grupo de 4 valores há um byte de controle com o tamanho (1 a 4
+ * bytes) de cada um, e os bytes dos valores ficam em um fluxo separado. Assim um grupo inteiro é
+ * decodificado com um único shuffle SIMD (SSSE3) seguido de uma soma de prefixos.
+ *
+ * Layout de uma linha com n filmes, a partir de row_movie_byte_offsets[u]:
+ *   [ceil(n / 4) bytes de controle][bytes dos deltas]
+ * O array completo termina com STREAMVBYTE_PADDING bytes zerados, para que a decodificação SIMD
+ * possa ler 16 bytes a partir de qualquer grupo sem sair do buffer.
+ *
+ * A decodificação é incremental (CompressedRowReader): os laços de similaridade e de pontuação
+ * consomem os índices à medida que são decodificados, sem materializar a linha.
+ *
+ * As listas de usuários dos buckets LSH (crescentes dentro de cada bucket) usam o mesmo formato,
+ * com `bucket_byte_offsets[h]` no lugar de `row_movie_byte_offsets[u]`.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "types.hpp"
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+constexpr size_t STREAMVBYTE_PADDING = 16;
+
+// Tabelas de decodificação indexadas pelo byte de controle.
+struct StreamVByteTables {
+    uint8_t shuffle[256][16]; // Máscara de _mm_shuffle_epi8 que espalha os bytes nos 4 inteiros
+    uint8_t length[256];      // Total de bytes de dados do grupo
+};
+extern const StreamVByteTables STREAMVBYTE_TABLES;
+
+/**
+ * @brief Decodifica um grupo de 4 deltas e os converte em índices absolutos (soma de prefixos + `prev`).
+ * @return Ponteiro para os dados do próximo grupo.
+ */
+inline const uint8_t* decodeStreamVByteGroup(uint8_t control, const uint8_t* data, int prev, int out[4]) {
+#if defined(__SSSE3__)
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(STREAMVBYTE_TABLES.shuffle[control]));
+    __m128i values = _mm_shuffle_epi8(raw, mask);
+    values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+    values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+    values = _mm_add_epi32(values, _mm_set1_epi32(prev));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), values);
+    return data + STREAMVBYTE_TABLES.length[control];
+#else
+    for (int i = 0; i < 4; ++i) {
+        int length = ((control >> (2 * i)) & 3) + 1;
+        uint32_t delta = 0;
+        std::memcpy(&delta, data, length); // Little-endian
+        data += length;
+        prev += static_cast<int>(delta);
+        out[i] = prev;
+    }
+    return data;
+#endif
+}
+
+/**
+ * @brief Percorre uma lista crescente comprimida ([bytes de controle][deltas]), decodificando 4 por vez.
+ */
+class StreamVByteReader {
+public:
+    StreamVByteReader(const uint8_t* encoded, uint32_t count)
+        : control_(encoded), data_(encoded + (count + 3) / 4), remaining_(count) {}
+
+    bool next(int& movie_idx) {
+        if (pos_ == available_) {
+            if (remaining_ == 0) return false;
+            data_ = decodeStreamVByteGroup(*control_++, data_, prev_, buffer_);
+            prev_ = buffer_[3];
+            available_ = std::min<uint32_t>(4, remaining_);
+            remaining_ -= available_;
+            pos_ = 0;
+        }
+        movie_idx = buffer_[pos_++];
+        return true;
+    }
+
+private:
+    const uint8_t* control_;
+    const uint8_t* data_;
+    uint32_t remaining_;
+    uint32_t pos_ = 0;
+    uint32_t available_ = 0;
+    int prev_ = 0;
+    alignas(16) int buffer_[4];
+};
+
+/**
+ * @brief Índices densos dos filmes de uma linha comprimida da matriz.
+ */
+class CompressedRowReader : public StreamVByteReader {
+public:
+    CompressedRowReader(const RatingMatrix& matrix, int user_idx)
+        : StreamVByteReader(matrix.row_movie_bytes.data() + matrix.row_movie_byte_offsets[user_idx],
+                            matrix.rowLength(user_idx)) {}
+};
+
+/**
+ * @brief Chama `fn(p, movie_idx)` para cada avaliação da linha do usuário, em ordem crescente de
+ * filme, em qualquer representação da matriz. `p` é a posição da avaliação nos arrays de notas.
+ */
+template <typename Fn>
+inline void forEachRowEntry(const RatingMatrix& matrix, int user_idx, Fn&& fn) {
+    uint32_t p = matrix.rowBegin(user_idx);
+    if (matrix.isCompressed()) {
+        CompressedRowReader reader(matrix, user_idx);
+        int movie_idx;
+        while (reader.next(movie_idx)) fn(p++, movie_idx);
+    } else {
+        const uint32_t row_end = matrix.rowEnd(user_idx);
+        for (; p < row_end; ++p) fn(p, matrix.row_movies[p]);
+    }
+}
+
+/**
+ * @brief Índices dos filmes de uma linha como array contíguo.
+ * @details Aponta direto para `row_movies` ou, se a matriz for comprimida, decodifica a linha
+ * inteira em `scratch` (que só cresce) e devolve `scratch.data()`.
+ */
+const int* rowMovieIndices(const RatingMatrix& matrix, int user_idx, std::vector<int>& scratch);
+
+/**
+ * @brief Comprime os índices de filmes de todas as linhas e libera `row_movies`.
+ * @details As notas continuam indexadas pela mesma posição `p` do CSR.
+ */
+void compressRatingRows(RatingMatrix& matrix);
+
+/**
+ * @brief Chama `fn(user_idx)` para cada membro do bucket, em ordem crescente, com a lista
+ * comprimida ou não. A lista comprimida é decodificada à medida que é consumida.
+ */
+template <typename Fn>
+inline void forEachBucketUser(const LSHTable& table, LSHHashValue hash, Fn&& fn) {
+    if (table.isCompressed()) {
+        StreamVByteReader reader(table.bucket_user_bytes.data() + table.bucket_byte_offsets[hash],
+                                 table.bucketEnd(hash) - table.bucketBegin(hash));
+        int user_idx;
+        while (reader.next(user_idx)) fn(user_idx);
+    } else {
+        for (uint32_t p = table.bucketBegin(hash); p < table.bucketEnd(hash); ++p) fn(table.bucket_users[p]);
+    }
+}
+
+/**
+ * @brief Membros do bucket como array contíguo (direto de `bucket_users` ou decodificados em `scratch`).
+ */
+const int* bucketUserIndices(const LSHTable& table, LSHHashValue hash, std::vector<int>& scratch);
+
+/**
+ * @brief Comprime as listas de usuários dos buckets (deltas + StreamVByte) e libera `bucket_users`.
+ * @details Os deltas entre membros consecutivos de um bucket são da ordem de U / 2^k, de modo que
+ * cada usuário ocupa 1 a 2 bytes em vez de 4 em cada tabela.
+ */
+void compressLSHBuckets(std::vector<LSHTable>& lsh_tables);
+
+#endif // COMPRESSED_ROWS_HPP
@@ -11,12 +11,18 @@ const std::string MOVIES_CSV_PATH = "datasets/movies.csv";
 const std::string FILTERED_DATASET_PATH = "outcome/filtered_dataset.dat";
 const std::string EXPLORE_USERS_PATH = "datasets/explore.dat";
 const std::string OUTPUT_RECOMMENDATIONS_PATH = "outcome/output.dat";
+const std::string OUTPUT_RECOMMENDATIONS_BINARY_PATH = "outcome/output.bin";
+const std::string ALL_USERS_RECOMMENDATIONS_PATH = "outcome/all_users_output.dat";
+const std::string ALL_USERS_RECOMMENDATIONS_BINARY_PATH = "outcome/all_users_output.bin";
 
 // Parâmetros de Recomendação e Filtragem
 const int MIN_RATINGS_PER_ENTITY = 50;
 const int K_NEIGHBORS = 10;
 const size_t NUM_RANDOM_USERS_TO_EXPLORE = 50;
 const int TOP_N_RECOMMENDATIONS = 5;
+// Job offline: recomenda para todos os usuários do modelo (em vez dos de explore.dat), em ordem
+// de localidade de bucket LSH, gravando em ALL_USERS_RECOMMENDATIONS_PATH.
+const bool RECOMMEND_ALL_USERS = false;
 
 // Processamento de CSV
 // Um buffer maior pode ajudar em I/O, mas consome mais RAM. 256MB é um bom começo.
@@ -25,9 +31,128 @@ const size_t CSV_READ_BUFFER_SIZE = 700 * 1024 * 1024;
 // Estes números são baseados no dataset MovieLens 25M após filtragem.
 const size_t NUM_EXPECTED_UNIQUE_USERS = 163000;
 const size_t NUM_EXPECTED_UNIQUE_MOVIES = 62500;
+// Ingestão incremental: o log bruto é guardado em RATINGS_SNAPSHOT_PATH junto com o byte e o
+// timestamp (watermark) até onde o CSV foi lido; as próximas execuções só leem o que foi acrescentado.
+// Cada atualização acrescenta um segmento ao snapshot; acima de RATINGS_SNAPSHOT_MAX_SEGMENTS ele é
+// regravado em um único segmento.
+const bool INCREMENTAL_RATINGS_INGESTION = false;
+const std::string RATINGS_SNAPSHOT_PATH = "outcome/ratings_snapshot.bin";
+const int RATINGS_SNAPSHOT_MAX_SEGMENTS = 16;
+
+// Guarda as notas da matriz densa como uint8_t em meias estrelas (1/4 da memória das notas em float)
+// e calcula os produtos internos do cosseno em aritmética inteira, com resultado exato.
+// Se alguma nota não for múltiplo de 0.5, a matriz permanece em float.
+const bool QUANTIZE_RATINGS = true;
+// Guarda os índices dos filmes de cada linha como deltas comprimidos (StreamVByte), ~1.3 byte
+// por avaliação em vez de 4; a decodificação acontece dentro dos laços de similaridade.
+const bool COMPRESS_RATING_ROWS = true;
+// Mesmo esquema para as listas de usuários dos buckets LSH: 1 a 2 bytes por usuário e tabela em
+// vez de 4, decodificadas durante a coleta de candidatos.
+const bool COMPRESS_LSH_BUCKETS = true;
+// Razão mínima entre os tamanhos de duas linhas para o produto interno esparso usar busca
+// exponencial (galloping) na linha longa em vez de percorrer as duas.
+const unsigned SPARSE_DOT_GALLOP_RATIO = 32;
+
+// Métrica de similaridade entre usuários, fixada em tempo de compilação: a busca de vizinhos
+// (LSH e grafo kNN) é instanciada só para a política escolhida (ver similarity_policies.hpp).
+// Médias e normas centradas dos usuários são pré-calculadas na construção do modelo quando a
+// métrica as usa.
+enum class SimilarityMetric {
+    COSINE,          // Cosseno das notas brutas (padrão)
+    ADJUSTED_COSINE, // Cosseno das notas centradas na média de cada usuário
+    PEARSON,         // Correlação de Pearson sobre os filmes avaliados pelos dois
+    JACCARD          // |filmes em comum| / |filmes avaliados por algum dos dois|
+};
+const SimilarityMetric SIMILARITY_METRIC = SimilarityMetric::COSINE;
 
 // Parâmetros LSH
 const int NUM_LSH_TABLES = 7;
 const int NUM_HYPERPLANES_PER_TABLE = 5; // k, o número de bits no hash. Deve ser <= 64
+// Pré-seleção dos candidatos pelo número de tabelas em que colidiram com o alvo: só recebem
+// cosseno exato os que colidiram em pelo menos LSH_MIN_CANDIDATE_COLLISIONS tabelas e, se
+// LSH_MAX_EXACT_CANDIDATES > 0, apenas os que mais colidiram até esse limite. Troca revocação
+// por menos avaliações exatas; 1 e 0 avaliam todos os candidatos.
+const int LSH_MIN_CANDIDATE_COLLISIONS = 1;
+const size_t LSH_MAX_EXACT_CANDIDATES = 0;
+// Assinaturas SimHash longas (bits por usuário, múltiplo de 64; 0 desativa). Antes do cosseno
+// exato, a distância de Hamming entre as assinaturas estima o ângulo entre os usuários: descarta
+// candidatos com similaridade estimada abaixo de SIMHASH_PREFILTER_MIN_SIMILARITY e, se
+// SIMHASH_PREFILTER_MAX_CANDIDATES > 0, mantém apenas os de maior similaridade estimada.
+// Com -1 e 0 não há corte e as assinaturas nem são calculadas.
+const int SIMHASH_SIGNATURE_BITS = 256;
+const float SIMHASH_PREFILTER_MIN_SIMILARITY = -1.0f;
+const size_t SIMHASH_PREFILTER_MAX_CANDIDATES = 0;
+const bool SIMHASH_PREFILTER_ENABLED = SIMHASH_SIGNATURE_BITS > 0 &&
+    (SIMHASH_PREFILTER_MIN_SIMILARITY > -1.0f || SIMHASH_PREFILTER_MAX_CANDIDATES > 0);
+
+// Grafo kNN offline de todos os usuários (NN-Descent semeado pelos buckets LSH). Quando ativo,
+// os vizinhos dos usuários do modelo vêm do grafo e a busca LSH deixa de ser feita na consulta.
+const bool USE_KNN_GRAPH = false;
+const int KNN_GRAPH_MAX_ITERATIONS = 10;
+const float KNN_GRAPH_SAMPLE_RATE = 0.5f;  // Fração de K vizinhos novos usada por junção local
+const float KNN_GRAPH_EARLY_STOP = 0.001f; // Para com menos de 0.1% de U * K atualizações por iteração
+
+// Modelo LSH fora da memória: depois de construído, o modelo é gravado em NUM_MODEL_SHARDS shards
+// (intervalos contíguos de usuários) e as consultas leem apenas os arquivos mapeados com mmap.
+const bool USE_SHARDED_MODEL = false;
+const int NUM_MODEL_SHARDS = 8;
+const std::string SHARDED_MODEL_DIRECTORY = "outcome/shards";
+// Processos workers locais, cada um com os shards s % NUM_SHARD_WORKERS == w (0: consultas no próprio processo).
+const int NUM_SHARD_WORKERS = 0;
+
+// Motor de recomendação usado na Fase 3
+enum class RecommenderEngineType {
+    LSH_USER_USER, // Vizinhos de usuário aproximados via LSH (padrão)
+    ITEM_ITEM,           // Similaridade item-item pré-computada offline
+    MATRIX_FACTORIZATION // Fatoração de matrizes treinada com SGD paralelo (Hogwild)
+};
+const RecommenderEngineType RECOMMENDER_ENGINE = RecommenderEngineType::LSH_USER_USER;
+
+// Parâmetros do modelo item-item
+const int ITEM_SIMILARITY_TOP_M = 50; // M, vizinhos guardados por filme
+const std::string ITEM_SIMILARITY_MODEL_PATH = "outcome/item_similarity.bin";
+
+// Parâmetros da fatoração de matrizes
+const int MF_NUM_FACTORS = 32;           // Dimensão dos fatores latentes
+const int MF_NUM_EPOCHS = 20;            // Passadas completas de SGD sobre as avaliações
+const float MF_LEARNING_RATE = 0.01f;
+const float MF_REGULARIZATION = 0.05f;
+
+// Filtro de gêneros das recomendações, no formato da coluna genres do movies.csv
+// (ex.: "Comedy|Romance"). Vazio = sem restrição.
+const std::string RECOMMENDATION_INCLUDE_GENRES = "";
+const std::string RECOMMENDATION_EXCLUDE_GENRES = "";
+
+// Orçamento por consulta LSH: prazo em microssegundos e máximo de candidatos com cosseno exato
+// (0 desativa cada limite). Os candidatos são avaliados em ordem de prioridade e, se o orçamento
+// acabar, a resposta usa o melhor encontrado e é marcada como parcial.
+const long QUERY_DEADLINE_MICROSECONDS = 0;
+const size_t QUERY_MAX_CANDIDATE_EVALUATIONS = 0;
+
+// Cache de vizinhos/recomendações por usuário (0 desativa o cache)
+const size_t RECOMMENDATION_CACHE_CAPACITY = 4096;
+
+// Formato do arquivo de recomendações
+enum class RecommendationsOutputFormat {
+    TEXT,  // outcome/output.dat: legível, com percentuais e títulos
+    BINARY // outcome/output.bin: registros de largura fixa (ver binary_output.hpp)
+};
+const RecommendationsOutputFormat RECOMMENDATIONS_OUTPUT_FORMAT = RecommendationsOutputFormat::TEXT;
+
+// Escrita de saída: chunks formatados com std::to_chars e gravados por um thread em segundo plano
+const size_t OUTPUT_CHUNK_SIZE = 4 * 1024 * 1024;  // Tamanho de cada write()
+const size_t OUTPUT_MAX_PENDING_CHUNKS = 8;        // Limita o pico de memória da fila de escrita
+const size_t OUTPUT_USERS_PER_BATCH = 1024;        // Usuários formatados em paralelo por lote
+
+// Posicionamento de memória (opcional; os padrões deixam tudo a cargo do sistema operacional).
+enum class MemoryPlacementPolicy {
+    OS_DEFAULT, // First-touch de quem preencheu o array (em geral a thread principal)
+    NODE_BLOCKS, // Blocos contíguos, um por nó NUMA, como um first-touch paralelo com schedule(static)
+    INTERLEAVE   // Páginas alternadas entre os nós: leituras aleatórias dividem a banda de todos
+};
+const MemoryPlacementPolicy MEMORY_PLACEMENT = MemoryPlacementPolicy::OS_DEFAULT;
+const bool USE_HUGE_PAGES = false;       // Páginas de 2 MB (THP) nos arrays grandes do modelo
+const bool ADVISE_MAPPED_INPUTS = false; // madvise(WILLNEED) nos CSVs mapeados com mmap
+const bool PIN_OPENMP_THREADS = false;   // Fixa cada thread OpenMP em uma CPU permitida
 
 #endif // CONFIG_HPP
\ No newline at end of file
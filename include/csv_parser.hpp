@@ -13,16 +13,26 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
 #include "types.hpp"
 
 /**
- * @brief Lê os títulos dos filmes de um arquivo CSV.
+ * @brief Lê o catálogo de filmes (títulos e gêneros) de um arquivo CSV.
+ * @details O arquivo é mapeado com mmap e dividido em blocos processados em paralelo.
+ * Os títulos são copiados para uma única arena de caracteres (sem uma std::string por filme)
+ * e a coluna de gêneros é convertida para uma máscara de bits (GenreMask).
  * @param movies_csv_path Caminho para o arquivo movies.csv (formato esperado: movieId,title,genres).
- * @return MovieTitlesMap Um mapa que associa o ID de cada filme ao seu título.
+ * @return MovieCatalog O catálogo compacto, na ordem do arquivo.
  */
-MovieTitlesMap readMovieTitles(const std::string& movies_csv_path);
+MovieCatalog readMovieCatalog(const std::string& movies_csv_path);
+
+/**
+ * @brief Converte uma lista de gêneros separados por '|' (ex.: "Comedy|Romance") em máscara.
+ * @details Gêneros desconhecidos são ignorados.
+ */
+GenreMask parseGenreMask(std::string_view genres);
 
 /**
  * @brief Lê as avaliações de um grande arquivo CSV de forma otimizada e paralela.
@@ -31,10 +41,42 @@ MovieTitlesMap readMovieTitles(const std::string& movies_csv_path);
  * entre múltiplas threads usando OpenMP, e depois combina os resultados.
  * @param ratings_csv_path Caminho para o arquivo ratings.csv.
  * @param users_ratings_log Referência para o mapa que será preenchido com os dados das avaliações.
- * O mapa é limpo antes da leitura.
+ * O mapa é limpo antes da leitura; as linhas são alocadas no recurso de memória do mapa
+ * (os logs intermediários de cada thread usam arenas próprias, liberadas ao final).
  */
 void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_ratings_log);
 
+// Como readRatingsCSVIncremental obteve o log de avaliações.
+enum class RatingsIngestionMode {
+    FULL,     // Sem snapshot válido: CSV lido por inteiro e snapshot recriado
+    TAIL,     // CSV apenas cresceu: lido só o trecho depois do último byte consumido
+    WATERMARK // CSV reescrito: lido por inteiro, aplicadas só as linhas mais novas que o watermark
+};
+
+struct RatingsIngestionStats {
+    RatingsIngestionMode mode = RatingsIngestionMode::FULL;
+    uint64_t bytes_parsed = 0; // Bytes do CSV efetivamente lidos nesta execução
+    size_t new_ratings = 0;    // Avaliações aplicadas sobre o snapshot
+    int64_t watermark = -1;    // Maior timestamp aplicado até agora
+};
+
+/**
+ * @brief Versão incremental de readRatingsCSV para um log de avaliações que só recebe linhas no fim.
+ * @details O snapshot guarda o log já lido, o byte do CSV até onde a leitura foi e o maior
+ * timestamp aplicado. Se o início do CSV e os bytes antes desse ponto não mudaram, apenas o trecho
+ * novo é lido (custo proporcional aos dados novos) e acrescentado ao snapshot como um segmento.
+ * Se o arquivo foi reescrito, ele é lido por inteiro, mas só as linhas com timestamp acima do
+ * watermark são aplicadas. Só linhas completas (terminadas em '\n') são consumidas: uma linha
+ * sendo escrita fica para a próxima execução. Falhas ao gravar o snapshot são apenas avisos.
+ * @param ratings_csv_path Caminho para o arquivo ratings.csv (userId,movieId,rating,timestamp).
+ * @param snapshot_path Arquivo do snapshot (criado se não existir).
+ * @param users_ratings_log Log de saída (limpo antes). Se o CSV apenas cresceu, tem o mesmo conteúdo
+ * de uma leitura completa.
+ */
+RatingsIngestionStats readRatingsCSVIncremental(const std::string& ratings_csv_path,
+                                                const std::string& snapshot_path,
+                                                UserRatingsLog& users_ratings_log);
+
 /**
  * @brief Conta o número total de avaliações feitas por cada usuário e recebidas por cada filme.
  * @details A contagem é paralelizada para acelerar o processo em grandes datasets.
@@ -68,7 +110,8 @@ void identifyValidEntities(const std::unordered_map<int, int>& user_rating_count
  * @param original_log O log de avaliações original e completo.
  * @param valid_user_ids Um conjunto de IDs de usuários que devem ser mantidos.
  * @param valid_movie_ids Um conjunto de IDs de filmes cujas avaliações devem ser mantidas.
- * @param filtered_log O log de avaliações resultante, contendo apenas os dados filtrados.
+ * @param filtered_log O log de avaliações resultante, contendo apenas os dados filtrados. Cada
+ * linha é criada com a capacidade exata no recurso de memória desse log.
  */
 void filterUserRatingsLog(const UserRatingsLog& original_log,
                         const std::unordered_set<int>& valid_user_ids,
@@ -77,7 +120,8 @@ void filterUserRatingsLog(const UserRatingsLog& original_log,
 
 /**
  * @brief Escreve o log de avaliações filtrado em um arquivo de saída.
- * @details A geração das strings de texto para o arquivo é feita em paralelo.
+ * @details A formatação é feita em paralelo, com std::to_chars, em chunks por thread que são
+ * gravados por um escritor assíncrono (a ordem das linhas não é garantida).
  * O formato de saída é: userID movieId1:rating1 movieId2:rating2 ...
  * @param output_path O caminho do arquivo de saída.
  * @param users_ratings_log O log de avaliações filtrado a ser escrito.
@@ -0,0 +1,103 @@
+#ifndef ITEM_SIMILARITY_HPP
+#define ITEM_SIMILARITY_HPP
+
+/**
+ * @file item_similarity.hpp
+ * @brief Motor alternativo de filtragem colaborativa baseada em itens (item-item).
+ *
+ * A similaridade entre filmes é pré-computada offline, em paralelo, a partir da matriz
+ * filtrada. Para cada filme guardamos apenas os M filmes mais similares, em um layout
+ * compacto (estilo CSR). Na consulta, basta percorrer os filmes avaliados pelo usuário
+ * alvo através dessas listas, de modo que a latência independe do número de usuários.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "types.hpp"
+#include "config.hpp" // Para RecommendationsOutputFormat
+
+class AsyncFileWriter; // Definido em output_writer.hpp
+
+/**
+ * @brief Modelo item-item truncado em top-M vizinhos por filme.
+ * @details Os vizinhos do filme de índice denso `i` ocupam as posições
+ * [neighbor_offsets[i], neighbor_offsets[i + 1]) de `neighbor_indices` e
+ * `neighbor_similarities`, ordenados por similaridade decrescente.
+ */
+struct ItemSimilarityModel {
+    int top_m = 0;
+    DenseIdxToMovieIdVec dense_idx_to_movie_id;  // Índice denso -> MovieID original
+    std::vector<uint32_t> neighbor_offsets;      // Tamanho D + 1
+    std::vector<int> neighbor_indices;           // Índices densos dos filmes vizinhos
+    std::vector<float> neighbor_similarities;    // Similaridade de cosseno de cada vizinho
+};
+
+/**
+ * @brief Constrói o modelo item-item a partir da matriz usuário-item filtrada.
+ * @details Cada thread processa um subconjunto de filmes usando um acumulador denso local:
+ * para cada usuário que avaliou o filme `i`, soma r(u,i) * r(u,j) para todos os filmes `j`
+ * do perfil desse usuário. Ao final, divide pelas normas dos filmes e mantém os top-M.
+ * @param matrix A matriz de avaliações densa (os índices do modelo são os índices densos dos filmes).
+ * @param top_m Número máximo de vizinhos guardados por filme.
+ * @return ItemSimilarityModel O modelo compacto.
+ */
+ItemSimilarityModel buildItemSimilarityModel(const RatingMatrix& matrix, int top_m);
+
+/**
+ * @brief Verifica se um modelo (possivelmente carregado do disco) usa o mesmo índice denso.
+ * @param model O modelo item-item.
+ * @param matrix A matriz de avaliações da execução atual.
+ * @return true se todo MovieID do modelo corresponde ao mesmo índice denso.
+ */
+bool isItemSimilarityModelCompatible(const ItemSimilarityModel& model, const RatingMatrix& matrix);
+
+/**
+ * @brief Salva o modelo em um arquivo binário compacto.
+ * @return true em caso de sucesso.
+ */
+bool saveItemSimilarityModel(const std::string& output_path, const ItemSimilarityModel& model);
+
+/**
+ * @brief Carrega um modelo salvo por saveItemSimilarityModel.
+ * @return true se o arquivo existe e tem o formato esperado.
+ */
+bool loadItemSimilarityModel(const std::string& input_path, ItemSimilarityModel& model);
+
+/**
+ * @brief Gera recomendações item-item para um usuário.
+ * @details Percorre apenas os filmes avaliados pelo usuário e as listas top-M desses filmes,
+ * prevendo a nota de cada filme não visto como a média ponderada pela similaridade.
+ * @param target_user_idx Índice denso do usuário alvo.
+ * @param matrix A matriz de avaliações densa.
+ * @param model O modelo item-item pré-computado (compatível com a matriz).
+ * @param top_n Número de recomendações a retornar.
+ * @param use_user_mean_filter Se true, descarta previsões abaixo da média do usuário.
+ * @param out_neighbor_stats Opcional: estatísticas das similaridades item-item percorridas.
+ * @param genre_filter Gêneros exigidos/excluídos, testados durante a acumulação.
+ * @return RecommendationList As top-N recomendações (índices densos) em ordem decrescente de nota prevista.
+ */
+RecommendationList generateRecommendationsItemBased(
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const ItemSimilarityModel& model,
+    int top_n,
+    bool use_user_mean_filter = true,
+    NeighborSimilarityStats* out_neighbor_stats = nullptr,
+    const GenreFilter& genre_filter = GenreFilter());
+
+/**
+ * @brief Gera recomendações item-item para múltiplos usuários em paralelo.
+ * @details As saídas, no mesmo formato do motor LSH, são gravadas em ordem pelo escritor assíncrono.
+ */
+void generateItemBasedRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RatingMatrix& matrix,
+    const ItemSimilarityModel& model,
+    const MovieCatalog& movie_catalog,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter = GenreFilter());
+
+#endif // ITEM_SIMILARITY_HPP
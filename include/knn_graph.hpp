@@ -0,0 +1,64 @@
+#ifndef KNN_GRAPH_HPP
+#define KNN_GRAPH_HPP
+
+/**
+ * @file knn_graph.hpp
+ * @brief Grafo kNN aproximado de todos os usuários, construído offline por NN-Descent.
+ *
+ * A lista de cada usuário começa com membros dos seus próprios buckets LSH (completada com
+ * usuários aleatórios) e é refinada por junções locais: "o vizinho do meu vizinho provavelmente
+ * é meu vizinho". Em cada iteração, os pares formados entre os vizinhos novos e antigos de cada
+ * usuário (diretos e reversos) recebem a similaridade exata (métrica de SIMILARITY_METRIC) e são
+ * oferecidos às duas listas; o processo para quando quase nenhuma lista muda. Com o grafo
+ * pronto, a consulta de um usuário do modelo lê K vizinhos contíguos, sem hash, candidatos ou
+ * similaridades.
+ */
+
+#include <cstdint>
+#include <vector>
+#include "types.hpp"
+
+/**
+ * @brief K vizinhos por usuário em um arranjo plano U x K.
+ * @details A linha do usuário `u` ocupa [u * k, (u + 1) * k) de `neighbor_users` e
+ * `neighbor_similarities`, em similaridade decrescente; posições vagas têm usuário -1.
+ */
+struct KnnGraph {
+    int k = 0;
+    int build_iterations = 0;                 // Iterações de NN-Descent executadas
+    std::vector<int> neighbor_users;          // Índices densos dos vizinhos
+    std::vector<float> neighbor_similarities; // Similaridade exata de cada vizinho
+
+    bool empty() const { return k == 0; }
+    int numUsers() const { return k > 0 ? static_cast<int>(neighbor_users.size() / k) : 0; }
+
+    /**
+     * @brief Copia para `out` até `max_neighbors` vizinhos de similaridade positiva do usuário,
+     * no mesmo formato de findApproximateKNearestNeighborsLSH.
+     */
+    void neighborsOf(int user_idx, int max_neighbors, NeighborList& out) const;
+};
+
+/**
+ * @brief Constrói o grafo kNN de todos os usuários por NN-Descent semeado pelos buckets LSH.
+ * @details As junções locais rodam em paralelo; cada lista é um heap de K posições protegido por
+ * um spinlock próprio, de modo que só colidem threads que atualizam o mesmo usuário.
+ * @param matrix Matriz de avaliações densa.
+ * @param user_norms Normas dos usuários.
+ * @param lsh_tables Tabelas LSH com `user_buckets` preenchido.
+ * @param k Vizinhos por usuário.
+ * @param max_iterations Limite de iterações de refinamento.
+ * @param sample_rate Fração de K vizinhos novos (e reversos) usada por usuário em cada junção.
+ * @param early_stop Para quando as atualizações de uma iteração ficam abaixo de early_stop * U * K.
+ * @param seed Semente dos vizinhos aleatórios iniciais e da amostragem.
+ */
+KnnGraph buildKnnGraphNNDescent(const RatingMatrix& matrix,
+                                const UserNormsVec& user_norms,
+                                const std::vector<LSHTable>& lsh_tables,
+                                int k,
+                                int max_iterations,
+                                float sample_rate,
+                                float early_stop,
+                                uint64_t seed);
+
+#endif // KNN_GRAPH_HPP
@@ -0,0 +1,88 @@
+#ifndef MATRIX_FACTORIZATION_HPP
+#define MATRIX_FACTORIZATION_HPP
+
+/**
+ * @file matrix_factorization.hpp
+ * @brief Motor de recomendação por fatoração de matrizes (modelo latente com vieses).
+ *
+ * O modelo aproxima cada nota por mu + b_u + b_i + <p_u, q_i>. O treino usa SGD paralelo
+ * sem locks (Hogwild): as atualizações de threads diferentes raramente tocam o mesmo fator,
+ * e as colisões ocasionais não prejudicam a convergência. Os fatores ficam em arrays
+ * contíguos e alinhados, de modo que o ranqueamento top-N é um produto interno vetorizado
+ * do fator do usuário contra todos os fatores de itens.
+ */
+
+#include <string>
+#include <vector>
+#include "types.hpp"
+#include "config.hpp" // Para RecommendationsOutputFormat
+
+class AsyncFileWriter; // Definido em output_writer.hpp
+
+/**
+ * @brief Modelo de fatoração treinado.
+ * @details Cada linha de `user_factors` / `item_factors` ocupa `stride` floats (num_factors
+ * arredondado para múltiplo de 16), de modo que toda linha começa alinhada em 64 bytes.
+ * As posições de preenchimento (padding) valem sempre zero.
+ */
+struct MatrixFactorizationModel {
+    int num_factors = 0;
+    int stride = 0;
+    float global_mean = 0.0f;
+    DenseIdxToMovieIdVec dense_idx_to_movie_id;    // Índice denso -> MovieID
+    AlignedFloatVector user_factors;               // num_users * stride (linha = índice denso do usuário)
+    AlignedFloatVector item_factors;               // D * stride
+    std::vector<float> user_bias;
+    std::vector<float> item_bias;
+};
+
+/**
+ * @brief Treina o modelo de fatoração com SGD paralelo (Hogwild).
+ * @param matrix A matriz de avaliações densa (linhas/itens do modelo seguem os índices densos).
+ * @param num_factors Dimensão dos fatores latentes.
+ * @param num_epochs Número de passadas sobre as avaliações.
+ * @param learning_rate Taxa de aprendizado do SGD.
+ * @param regularization Coeficiente de regularização L2.
+ * @return MatrixFactorizationModel O modelo treinado.
+ */
+MatrixFactorizationModel trainMatrixFactorization(const RatingMatrix& matrix,
+                                                  int num_factors,
+                                                  int num_epochs,
+                                                  float learning_rate,
+                                                  float regularization);
+
+/**
+ * @brief Gera as top-N recomendações de um usuário pelo modelo de fatoração.
+ * @details Calcula o produto interno vetorizado do fator do usuário contra todos os itens,
+ * excluindo os filmes já avaliados, e seleciona os N maiores.
+ * @param target_user_idx Índice denso do usuário alvo.
+ * @param matrix A matriz de avaliações (para excluir filmes já vistos).
+ * @param model O modelo treinado.
+ * @param top_n Número de recomendações a retornar.
+ * @param out_neighbor_stats Opcional: estatísticas do cosseno entre o fator do usuário e os itens recomendados.
+ * @param genre_filter Gêneros exigidos/excluídos; itens rejeitados nem têm o produto interno calculado.
+ * @return RecommendationList Recomendações (índices densos) com a nota prevista, em ordem decrescente.
+ */
+RecommendationList generateRecommendationsMF(
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const MatrixFactorizationModel& model,
+    int top_n,
+    NeighborSimilarityStats* out_neighbor_stats = nullptr,
+    const GenreFilter& genre_filter = GenreFilter());
+
+/**
+ * @brief Gera recomendações por fatoração para múltiplos usuários em paralelo.
+ * @details As saídas, no mesmo formato do motor LSH, são gravadas em ordem pelo escritor assíncrono.
+ */
+void generateMFRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RatingMatrix& matrix,
+    const MatrixFactorizationModel& model,
+    const MovieCatalog& movie_catalog,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter = GenreFilter());
+
+#endif // MATRIX_FACTORIZATION_HPP
@@ -0,0 +1,54 @@
+#ifndef MEMORY_PLACEMENT_HPP
+#define MEMORY_PLACEMENT_HPP
+
+/**
+ * @file memory_placement.hpp
+ * @brief Camada opcional de posicionamento de memória: NUMA, huge pages, madvise e afinidade.
+ *
+ * Os arrays grandes do modelo são preenchidos por uma thread e, sem intervenção, ficam no nó NUMA
+ * dela; as threads dos outros sockets passam a ler tudo remotamente. Aqui, depois de prontos, os
+ * arrays somente-leitura são redistribuídos com mbind (intercalados ou em blocos por nó) e podem
+ * ser promovidos a páginas de 2 MB. Tudo usa chamadas de sistema diretas (sem libnuma) e falhas
+ * são apenas avisos: a execução continua com o posicionamento padrão.
+ */
+
+#include <cstddef>
+#include <vector>
+#include "config.hpp"
+
+/**
+ * @brief Número de nós NUMA online (1 se a topologia não puder ser lida).
+ */
+int numaNodeCount();
+
+/**
+ * @brief Aplica a política de posicionamento e as huge pages a um array somente-leitura.
+ * @details As páginas já existentes são migradas (MPOL_MF_MOVE). Com USE_HUGE_PAGES a região é
+ * marcada com MADV_HUGEPAGE e, se o kernel suportar, consolidada na hora com MADV_COLLAPSE.
+ * @return false se alguma chamada falhou (o array continua válido).
+ */
+bool placeReadMostlyMemory(const void* data, size_t bytes, MemoryPlacementPolicy policy, bool huge_pages);
+
+template <typename T, typename Allocator>
+bool placeReadMostlyArray(const std::vector<T, Allocator>& array, MemoryPlacementPolicy policy, bool huge_pages) {
+    return placeReadMostlyMemory(array.data(), array.size() * sizeof(T), policy, huge_pages);
+}
+
+/**
+ * @brief Dicas para um arquivo de entrada mapeado com mmap: leitura antecipada (MADV_WILLNEED) e,
+ * com USE_HUGE_PAGES, MADV_HUGEPAGE (efetivo apenas em kernels com THP para arquivos).
+ */
+void adviseMappedInput(void* data, size_t bytes);
+
+/**
+ * @brief Fixa cada thread da equipe OpenMP em uma CPU do conjunto permitido ao processo.
+ * @details A thread i fica na i-ésima CPU permitida (módulo o total): com a numeração usual, os
+ * blocos de um schedule(static) caem em CPUs vizinhas do mesmo nó. A equipe é reaproveitada pelo
+ * runtime, então a afinidade vale para as regiões paralelas seguintes da thread chamadora. A
+ * própria thread chamadora não é fixada: threads criadas por ela depois (escritor assíncrono,
+ * estágios do pipeline) herdam a afinidade e não podem ficar presas a uma única CPU.
+ * @return Número de threads fixadas.
+ */
+int pinOpenMPThreads();
+
+#endif // MEMORY_PLACEMENT_HPP
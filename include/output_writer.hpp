@@ -0,0 +1,135 @@
+#ifndef OUTPUT_WRITER_HPP
+#define OUTPUT_WRITER_HPP
+
+/**
+ * @file output_writer.hpp
+ * @brief Camada de formatação sem alocações e escrita assíncrona de arquivos de saída.
+ *
+ * Os números são formatados com `std::to_chars` diretamente em buffers (chunks) de
+ * capacidade fixa, reutilizados entre escritas. Um thread escritor em segundo plano
+ * recebe os chunks prontos e os grava com chamadas `write()` grandes, enquanto as threads
+ * de cálculo continuam produzindo. O número de chunks em trânsito é limitado, então o pico
+ * de memória é ~(max_pending_chunks + threads) * chunk_capacity, independente do tamanho da saída.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// --- Formatação com std::to_chars (sem std::to_string / ostringstream) ---
+
+inline void appendInt(std::string& out, long long value) {
+    char buffer[24];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, ptr - buffer);
+}
+
+/**
+ * @brief Acrescenta `value` em notação fixa com `precision` casas decimais (equivale a "%.*f").
+ */
+inline void appendFixed(std::string& out, double value, int precision) {
+    char buffer[64];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, precision);
+    out.append(buffer, ptr - buffer);
+}
+
+inline void appendText(std::string& out, std::string_view text) {
+    out.append(text.data(), text.size());
+}
+
+/**
+ * @brief Escritor de arquivo com thread em segundo plano e pool de chunks reutilizáveis.
+ * @details `submit` é thread-safe: várias threads podem entregar chunks ao mesmo tempo.
+ * Os chunks são gravados na ordem em que foram entregues.
+ */
+class AsyncFileWriter {
+public:
+    AsyncFileWriter(const std::string& output_path, size_t chunk_capacity, size_t max_pending_chunks);
+    ~AsyncFileWriter();
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    bool isOpen() const { return fd_ != -1; }
+    size_t chunkCapacity() const { return chunk_capacity_; }
+
+    /**
+     * @brief Obtém um chunk vazio (com capacidade reservada) do pool.
+     */
+    std::string acquireChunk();
+
+    /**
+     * @brief Entrega um chunk para escrita. Bloqueia se já houver chunks demais pendentes.
+     */
+    void submit(std::string&& chunk);
+
+    /**
+     * @brief Espera todos os chunks pendentes serem gravados e fecha o arquivo.
+     * @return true se todas as escritas tiveram sucesso.
+     */
+    bool finish();
+
+private:
+    void writerLoop();
+
+    int fd_ = -1;
+    size_t chunk_capacity_;
+    size_t max_pending_chunks_;
+    std::mutex mutex_;
+    std::condition_variable has_pending_;
+    std::condition_variable has_room_;
+    std::deque<std::string> pending_;
+    std::vector<std::string> free_chunks_;
+    bool closing_ = false;
+    bool failed_ = false;
+    std::thread writer_thread_;
+};
+
+/**
+ * @brief Gera saídas por usuário em paralelo e as grava na ordem original, em lotes.
+ * @details Cada usuário do lote é formatado em um buffer próprio (reutilizado entre lotes,
+ * mantendo a capacidade); ao fim do lote os buffers são copiados, em ordem, para chunks
+ * entregues ao escritor assíncrono, que grava enquanto o próximo lote é calculado.
+ * @param num_users Número de usuários (índices 0 a num_users-1).
+ * @param format_user Função `void(size_t idx, std::string& out)` que acrescenta a saída do usuário.
+ * @param writer O escritor de destino.
+ * @param users_per_batch Tamanho do lote.
+ */
+template <typename FormatUserFn>
+void streamOrderedUserOutputs(size_t num_users, FormatUserFn&& format_user,
+                              AsyncFileWriter& writer, size_t users_per_batch) {
+    std::vector<std::string> slots(std::min(users_per_batch, num_users));
+    std::string chunk = writer.acquireChunk();
+
+    for (size_t batch_start = 0; batch_start < num_users; batch_start += users_per_batch) {
+        size_t batch_size = std::min(users_per_batch, num_users - batch_start);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < batch_size; ++i) {
+            slots[i].clear();
+            format_user(batch_start + i, slots[i]);
+        }
+
+        for (size_t i = 0; i < batch_size; ++i) {
+            chunk += slots[i];
+            if (chunk.size() >= writer.chunkCapacity()) {
+                writer.submit(std::move(chunk));
+                chunk = writer.acquireChunk();
+            }
+        }
+    }
+    if (!chunk.empty()) writer.submit(std::move(chunk));
+}
+
+#endif // OUTPUT_WRITER_HPP
@@ -0,0 +1,36 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+/**
+ * @file pipeline.hpp
+ * @brief Estágios concorrentes do pipeline de main(), ligados por dependências.
+ *
+ * Cada estágio roda em um thread próprio assim que os estágios de que depende terminam, de modo
+ * que etapas independentes (ex.: títulos dos filmes e avaliações, ou a gravação do dataset
+ * filtrado e a construção do índice) se sobrepõem e o tempo total se aproxima do caminho crítico.
+ * Estágios que usam OpenMP abrem a própria equipe de threads.
+ */
+
+#include <future>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Inicia `stage` em segundo plano depois que todas as dependências terminarem.
+ * @param stage Função sem argumentos; os dados de entrada são capturados por ela.
+ * @param dependencies Estágios (shared_future) que precisam terminar antes.
+ * @return Future com o resultado do estágio; `.share()` o transforma em dependência de outros.
+ * @note O destrutor do future espera o estágio terminar, então dados capturados por referência
+ * devem viver mais que o future.
+ */
+template <typename Stage, typename... Dependencies>
+std::future<std::invoke_result_t<Stage>> startPipelineStage(Stage&& stage,
+                                                            std::shared_future<Dependencies>... dependencies) {
+    return std::async(std::launch::async,
+                      [stage = std::forward<Stage>(stage), dependencies...]() mutable {
+                          (dependencies.wait(), ...);
+                          return stage();
+                      });
+}
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,132 @@
+#ifndef RECOMMENDATION_CACHE_HPP
+#define RECOMMENDATION_CACHE_HPP
+
+/**
+ * @file recommendation_cache.hpp
+ * @brief Cache limitado e thread-safe de listas de vizinhos e de recomendações top-N por usuário.
+ *
+ * Em cargas de lote ou de serviço os mesmos usuários são consultados repetidamente
+ * (o próprio explore.dat contém IDs duplicados). O cache evita recalcular hashes,
+ * candidatos, cossenos e scores nesses casos.
+ *
+ * O cache é dividido em shards, cada um com um `std::shared_mutex`: leituras concorrentes
+ * usam lock compartilhado e apenas inserções/invalidações usam lock exclusivo. A política
+ * de remoção é CLOCK (aproximação de LRU), que só precisa marcar um bit atômico na leitura.
+ *
+ * As chaves são os índices densos dos usuários na RatingMatrix (não os UserIDs do CSV).
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+
+/**
+ * @brief Métricas agregadas do cache.
+ */
+struct RecommendationCacheStats {
+    uint64_t neighbor_hits = 0;
+    uint64_t neighbor_misses = 0;
+    uint64_t recommendation_hits = 0;
+    uint64_t recommendation_misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+
+    double neighborHitRate() const {
+        uint64_t total = neighbor_hits + neighbor_misses;
+        return total ? static_cast<double>(neighbor_hits) / total : 0.0;
+    }
+    double recommendationHitRate() const {
+        uint64_t total = recommendation_hits + recommendation_misses;
+        return total ? static_cast<double>(recommendation_hits) / total : 0.0;
+    }
+};
+
+class RecommendationCache {
+public:
+    /**
+     * @param capacity Número máximo de usuários mantidos no cache (somando todos os shards).
+     * @param num_shards Número de shards independentes (reduz contenção de locks).
+     */
+    explicit RecommendationCache(size_t capacity, size_t num_shards = 16);
+
+    RecommendationCache(const RecommendationCache&) = delete;
+    RecommendationCache& operator=(const RecommendationCache&) = delete;
+
+    /**
+     * @brief Busca a lista de vizinhos de um usuário.
+     * @return true em caso de acerto; `out_neighbors` recebe uma cópia da lista.
+     */
+    bool lookupNeighbors(int user_id, NeighborList& out_neighbors) const;
+
+    /**
+     * @brief Busca as recomendações de um usuário.
+     * @details Só há acerto se a entrada foi gravada com pelo menos `top_n` recomendações
+     * (ou se a lista completa tinha menos que isso).
+     * @return true em caso de acerto.
+     */
+    bool lookupRecommendations(int user_id, int top_n,
+                               RecommendationList& out_recommendations,
+                               NeighborSimilarityStats& out_neighbor_stats) const;
+
+    void storeNeighbors(int user_id, const NeighborList& neighbors);
+
+    /**
+     * @brief Grava as top-N recomendações de um usuário (a lista é truncada em `top_n`).
+     */
+    void storeRecommendations(int user_id, int top_n,
+                              const RecommendationList& recommendations,
+                              const NeighborSimilarityStats& neighbor_stats);
+
+    /**
+     * @brief Remove as entradas de um usuário (ex.: suas avaliações mudaram).
+     */
+    void invalidateUser(int user_id);
+
+    /**
+     * @brief Remove todas as entradas (ex.: o índice LSH ou a matriz foram reconstruídos).
+     */
+    void invalidateAll();
+
+    RecommendationCacheStats stats() const;
+
+private:
+    struct Slot {
+        int user_id = -1;
+        bool has_neighbors = false;
+        bool has_recommendations = false;
+        int stored_top_n = 0;
+        NeighborSimilarityStats neighbor_stats;
+        NeighborList neighbors;
+        RecommendationList recommendations;
+        mutable std::atomic<bool> referenced{false}; // Bit de referência do CLOCK
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity = 0;
+        size_t clock_hand = 0;
+        std::unordered_map<int, size_t> slot_of_user;
+    };
+
+    Shard& shardFor(int user_id) const;
+    // Retorna o slot do usuário, alocando (e possivelmente removendo outro) se necessário.
+    // Deve ser chamada com o lock exclusivo do shard.
+    Slot& acquireSlot(Shard& shard, int user_id);
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t num_shards_;
+
+    mutable std::atomic<uint64_t> neighbor_hits_{0};
+    mutable std::atomic<uint64_t> neighbor_misses_{0};
+    mutable std::atomic<uint64_t> recommendation_hits_{0};
+    mutable std::atomic<uint64_t> recommendation_misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> invalidations_{0};
+};
+
+#endif // RECOMMENDATION_CACHE_HPP
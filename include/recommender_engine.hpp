@@ -2,14 +2,46 @@
 #define RECOMMENDER_ENGINE_HPP
 
 #include "types.hpp" 
+#include "config.hpp" // Para RecommendationsOutputFormat
 #include <random> // Para geração de números aleatórios
+#include <unordered_set>
 
-UserItemMatrix convertToUserItemMatrix(const UserRatingsLog& users_ratings_log);
-UserNormsMap computeUserNorms(const UserItemMatrix& user_item_matrix); // Mantido
+class RecommendationCache; // Definido em recommendation_cache.hpp
+class AsyncFileWriter;     // Definido em output_writer.hpp
+struct KnnGraph;           // Definido em knn_graph.hpp
 
-// Função de similaridade de cosseno exata (mantida)
-float calculateCosineSimilarity(const std::unordered_map<int, float>& ratings_user_a,
-                                const std::unordered_map<int, float>& ratings_user_b,
+/**
+ * @brief Atribui índices densos (0 a N-1) aos IDs externos, na ordem em que aparecem.
+ * @details IDs negativos ou repetidos são ignorados. A busca inversa é um vetor indexado pelo ID.
+ */
+DenseIdMap buildDenseIdMap(const std::vector<int>& external_ids);
+
+/**
+ * @brief Constrói a matriz CSR densa a partir do log de avaliações filtrado.
+ * @details É a única etapa que traduz IDs externos: usuários e filmes recebem índices em ordem
+ * crescente de ID, de modo que o resultado não depende do número de threads da ingestão.
+ * @param users_ratings_log Avaliações filtradas por usuário.
+ * @param valid_movie_ids Filmes que compõem o espaço de itens.
+ * @param quantize_ratings Se true, guarda as notas como uint8_t em meias estrelas (se todas forem representáveis).
+ * @param compress_rows Se true, guarda os índices dos filmes como deltas em StreamVByte.
+ * @return RatingMatrix A matriz com as linhas ordenadas por índice denso do filme.
+ */
+RatingMatrix buildRatingMatrix(const UserRatingsLog& users_ratings_log,
+                               const std::unordered_set<int>& valid_movie_ids,
+                               bool quantize_ratings = false,
+                               bool compress_rows = false);
+
+/**
+ * @brief Preenche `matrix.movie_genres` (máscaras de gêneros por índice denso) a partir do catálogo.
+ */
+void attachMovieGenres(RatingMatrix& matrix, const MovieCatalog& movie_catalog);
+
+UserNormsVec computeUserNorms(const RatingMatrix& matrix);
+
+// Função de similaridade de cosseno exata entre as linhas de dois usuários (índices densos)
+float calculateCosineSimilarity(const RatingMatrix& matrix,
+                                int user_a,
+                                int user_b,
                                 float norm_user_a,
                                 float norm_user_b);
 
@@ -26,63 +58,118 @@ float calculateCosineSimilarity(const std::unordered_map<int, float>& ratings_us
 HyperplaneSet generateSingleHyperplaneSet(int num_hyperplanes, int dimensionality, std::mt19937& rng);
 
 /**
- * @brief Calcula o hash LSH para um vetor de avaliações de usuário usando um conjunto de hiperplanos.
- * @param user_ratings Mapa de (MovieID -> Rating) para o usuário.
+ * @brief Calcula o hash LSH da linha de avaliações de um usuário usando um conjunto de hiperplanos.
+ * @param matrix A matriz de avaliações densa.
+ * @param user_idx Índice denso do usuário.
  * @param hyperplane_set O conjunto de hiperplanos para esta tabela hash.
- * @param movie_to_idx Mapeamento de MovieID para índice de vetor denso.
- * @param dimensionality A dimensionalidade total (para consistência, embora não diretamente usada se o hiperplano já tiver o tamanho certo).
  * @return LSHHashValue O valor do hash.
  */
-LSHHashValue computeLSHHash(const std::unordered_map<int, float>& user_ratings,
-                            const HyperplaneSet& hyperplane_set,
-                            const MovieIdToDenseIdxMap& movie_to_idx);
+LSHHashValue computeLSHHash(const RatingMatrix& matrix,
+                            int user_idx,
+                            const HyperplaneSet& hyperplane_set);
 /**
  * @brief Constrói múltiplas tabelas hash LSH.
- * @param user_item_matrix A matriz de avaliações usuário-item.
+ * @param matrix A matriz de avaliações densa.
  * @param all_hyperplane_sets Vetor contendo conjuntos de hiperplanos para cada tabela LSH.
- * @param movie_to_idx Mapeamento de MovieID para índice de vetor denso.
- * @param lsh_tables Vetor de saída de tabelas hash LSH (mapas de bucket).
+ * @param lsh_tables Vetor de saída de tabelas hash LSH (2^k buckets cada).
  */
-void buildLSHTables(const UserItemMatrix& user_item_matrix,
+void buildLSHTables(const RatingMatrix& matrix,
                     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-                    const MovieIdToDenseIdxMap& movie_to_idx,
-                    std::vector<LSHBucketMap>& lsh_tables);
+                    std::vector<LSHTable>& lsh_tables);
 
 /**
  * @brief Encontra K vizinhos mais próximos aproximados para um usuário alvo usando LSH.
- * Coleta candidatos de buckets LSH e então calcula similaridade de cosseno exata para eles.
- * @param target_user_id O ID do usuário.
- * @param user_item_matrix A matriz completa de avaliações.
+ * Coleta candidatos de buckets LSH contando em quantas tabelas cada um colidiu com o alvo e
+ * calcula a similaridade exata (política de SIMILARITY_METRIC, ver similarity_policies.hpp)
+ * apenas para os que passam pelos limites de colisão.
+ * @param target_user_idx Índice denso do usuário.
+ * @param matrix A matriz de avaliações densa.
  * @param user_norms Normas pré-calculadas para todos os usuários.
  * @param all_hyperplane_sets Todos os conjuntos de hiperplanos para todas as tabelas LSH.
  * @param lsh_tables As tabelas hash LSH construídas.
- * @param movie_to_idx Mapeamento de MovieID para índice de vetor denso.
  * @param K O número de vizinhos a retornar.
- * @return NeighborList Lista de vizinhos aproximados.
+ * @param signatures Opcional: assinaturas SimHash para o pré-filtro por distância de Hamming
+ * (limites SIMHASH_PREFILTER_* de config.hpp), aplicado antes do cosseno exato.
+ * @param min_collisions Número mínimo de tabelas em que o candidato colidiu com o alvo.
+ * @param max_exact_candidates Se > 0, limita o cosseno exato aos candidatos com mais colisões.
+ * @param budget Opcional: prazo/limite de avaliações. Os candidatos são avaliados em ordem de
+ * prioridade e, se o orçamento acabar, devolve os melhores encontrados e marca `budget->degraded`.
+ * @return NeighborList Lista de vizinhos aproximados (índices densos).
  */
 NeighborList findApproximateKNearestNeighborsLSH(
-    int target_user_id,
-    const UserItemMatrix& user_item_matrix,
-    const UserNormsMap& user_norms,
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
-    int K);
+    const std::vector<LSHTable>& lsh_tables,
+    int K,
+    const SimHashSignatures* signatures = nullptr,
+    int min_collisions = LSH_MIN_CANDIDATE_COLLISIONS,
+    size_t max_exact_candidates = LSH_MAX_EXACT_CANDIDATES,
+    QueryBudget* budget = nullptr);
 
-// Função de recomendação agora usará LSH para encontrar vizinhos
+/**
+ * @brief Variante que grava os vizinhos em `neighbors_out` (a capacidade é reaproveitada).
+ * @details Os buffers de trabalho são por thread: em regime a consulta não aloca memória.
+ */
+void findApproximateKNearestNeighborsLSH(
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
+    const std::vector<HyperplaneSet>& all_hyperplane_sets,
+    const std::vector<LSHTable>& lsh_tables,
+    int K,
+    NeighborList& neighbors_out,
+    const SimHashSignatures* signatures = nullptr,
+    int min_collisions = LSH_MIN_CANDIDATE_COLLISIONS,
+    size_t max_exact_candidates = LSH_MAX_EXACT_CANDIDATES,
+    QueryBudget* budget = nullptr);
+
+/**
+ * @brief Gera recomendações para um usuário a partir dos vizinhos LSH.
+ * @details Se `genre_filter` estiver ativo e a matriz tiver gêneros associados, cada filme
+ * candidato passa por um teste de máscara de bits durante a acumulação, antes da seleção
+ * top-N — consultas filtradas não custam mais que as não filtradas.
+ * @return RecommendationList Todas as recomendações (índices densos dos filmes), em ordem decrescente.
+ */
 RecommendationList generateRecommendationsLSH(
-    int target_user_id,
+    int target_user_idx,
     int K_neighbors_for_recs, // K para o LSH
-    const UserItemMatrix& all_user_ratings,
-    const UserNormsMap& user_norms,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
+    const std::vector<LSHTable>& lsh_tables,
     const NeighborList* precomputed_neighbors = nullptr,
     float similarity_threshold = 0.2f, // Novo parâmetro: threshold de similaridade
-    bool use_user_mean_filter = true    // Novo parâmetro: filtrar recomendações abaixo da média do usuário
+    bool use_user_mean_filter = true,    // Novo parâmetro: filtrar recomendações abaixo da média do usuário
+    const GenreFilter& genre_filter = GenreFilter(), // Gêneros exigidos/excluídos
+    const SimHashSignatures* signatures = nullptr,   // Pré-filtro SimHash dos candidatos
+    QueryBudget* budget = nullptr                    // Prazo/limite; marca budget->degraded se acabar
 );
 
+/**
+ * @brief Variante que grava as recomendações em `recommendations_out` (a capacidade é reaproveitada).
+ */
+void generateRecommendationsLSH(
+    int target_user_idx,
+    int K_neighbors_for_recs,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
+    const std::vector<HyperplaneSet>& all_hyperplane_sets,
+    const std::vector<LSHTable>& lsh_tables,
+    RecommendationList& recommendations_out,
+    const NeighborList* precomputed_neighbors = nullptr,
+    float similarity_threshold = 0.2f,
+    bool use_user_mean_filter = true,
+    const GenreFilter& genre_filter = GenreFilter(),
+    const SimHashSignatures* signatures = nullptr,
+    QueryBudget* budget = nullptr);
+
+/**
+ * @brief Trunca a lista em `top_n` e converte os índices densos dos filmes em MovieIDs.
+ */
+void restoreExternalMovieIds(RecommendationList& recommendations, const RatingMatrix& matrix, int top_n);
+
 // --- Fase 3: Recommendation Generation Functions ---
 
 /**
@@ -106,51 +193,115 @@ std::ofstream prepareRecommendationsOutput(const std::string& output_path,
                                          int num_tables, int num_hyperplanes);
 
 /**
- * @brief Processa recomendações para um usuário específico.
+ * @brief Acrescenta ao buffer as top-N recomendações de um usuário no formato de texto de saída.
+ * @details Compartilhada por todos os motores de recomendação (LSH, item-item, ...). Os números
+ * são formatados com std::to_chars e os títulos são copiados direto do mapa para o buffer.
+ * @param output Buffer de destino (o conteúdo existente é preservado).
  * @param target_user_id ID do usuário alvo.
- * @param user_item_matrix Matriz de avaliações usuário-item.
+ * @param mean_similarity Similaridade média reportada no cabeçalho do usuário.
+ * @param recommendations Recomendações ordenadas por nota prevista decrescente.
+ * @param movie_catalog Mapeamento de IDs para títulos de filmes.
+ * @param top_n Número máximo de recomendações a escrever.
+ * @param degraded Se true, marca no cabeçalho do usuário que o resultado é parcial (orçamento esgotado).
+ */
+void appendUserRecommendations(
+    std::string& output,
+    int target_user_id,
+    float mean_similarity,
+    const RecommendationList& recommendations,
+    const MovieCatalog& movie_catalog,
+    int top_n,
+    bool degraded = false);
+
+/**
+ * @brief Acrescenta ao buffer a saída de um usuário no formato escolhido (texto ou binário).
+ * @param output Buffer de destino.
+ * @param format Formato da saída (ver RecommendationsOutputFormat).
+ * @param target_user_id ID do usuário alvo.
+ * @param neighbor_stats Estatísticas das similaridades dos vizinhos usados.
+ * @param recommendations Recomendações ordenadas por nota prevista decrescente.
+ * @param movie_catalog Mapeamento de IDs para títulos (usado apenas no formato texto).
+ * @param top_n Número máximo de recomendações a escrever.
+ */
+void appendUserOutput(
+    std::string& output,
+    RecommendationsOutputFormat format,
+    int target_user_id,
+    const NeighborSimilarityStats& neighbor_stats,
+    const RecommendationList& recommendations,
+    const MovieCatalog& movie_catalog,
+    int top_n);
+
+/**
+ * @brief Calcula quantidade, média, mínimo e máximo das similaridades de uma lista de vizinhos.
+ */
+NeighborSimilarityStats computeNeighborSimilarityStats(const NeighborList& neighbors);
+
+/**
+ * @brief Processa recomendações para um usuário específico.
+ * @param target_user_id ID externo do usuário alvo (convertido para índice denso aqui).
+ * @param matrix Matriz de avaliações densa.
  * @param user_norms Normas dos usuários.
  * @param all_hyperplane_sets Conjuntos de hiperplanos LSH.
  * @param lsh_tables Tabelas hash LSH.
- * @param movie_to_idx Mapeamento de IDs de filmes.
- * @param movie_titles Mapeamento de IDs para títulos de filmes.
+ * @param movie_catalog Mapeamento de IDs para títulos de filmes.
  * @param k_neighbors Número de vizinhos para usar.
  * @param top_n Número de recomendações a retornar.
- * @return std::string Saída formatada das recomendações.
+ * @param output Buffer onde a saída formatada do usuário é acrescentada.
+ * @param format Formato da saída (texto ou binário).
+ * @param genre_filter Gêneros exigidos/excluídos nas recomendações.
+ * @param cache Opcional: cache de vizinhos e recomendações consultado antes de recalcular.
+ * @param signatures Opcional: assinaturas SimHash para o pré-filtro de candidatos.
+ * @param knn_graph Opcional: grafo kNN pré-computado; se presente, substitui a busca LSH.
  */
-std::string processUserRecommendations(
+void processUserRecommendations(
     int target_user_id,
-    const UserItemMatrix& user_item_matrix,
-    const UserNormsMap& user_norms,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
-    const MovieTitlesMap& movie_titles,
+    const std::vector<LSHTable>& lsh_tables,
+    const MovieCatalog& movie_catalog,
     int k_neighbors,
-    int top_n);
+    int top_n,
+    std::string& output,
+    RecommendationsOutputFormat format = RecommendationsOutputFormat::TEXT,
+    const GenreFilter& genre_filter = GenreFilter(),
+    RecommendationCache* cache = nullptr,
+    const SimHashSignatures* signatures = nullptr,
+    const KnnGraph* knn_graph = nullptr);
 
 /**
  * @brief Gera recomendações para múltiplos usuários em paralelo.
- * @param explore_user_ids Lista de IDs de usuários para processar.
- * @param user_item_matrix Matriz de avaliações usuário-item.
+ * @param explore_user_ids Lista de IDs externos de usuários para processar.
+ * @param matrix Matriz de avaliações densa.
  * @param user_norms Normas dos usuários.
  * @param all_hyperplane_sets Conjuntos de hiperplanos LSH.
  * @param lsh_tables Tabelas hash LSH.
- * @param movie_to_idx Mapeamento de IDs de filmes.
- * @param movie_titles Mapeamento de IDs para títulos de filmes.
+ * @param movie_catalog Mapeamento de IDs para títulos de filmes.
  * @param k_neighbors Número de vizinhos para usar.
+ * @details As saídas são gravadas pelo escritor assíncrono na mesma ordem de explore_user_ids.
  * @param top_n Número de recomendações por usuário.
- * @return std::vector<std::string> Lista de saídas formatadas.
+ * @param writer Escritor assíncrono do arquivo de saída.
+ * @param format Formato da saída (texto ou binário).
+ * @param genre_filter Gêneros exigidos/excluídos nas recomendações.
+ * @param cache Opcional: cache compartilhado entre as threads.
+ * @param signatures Opcional: assinaturas SimHash para o pré-filtro de candidatos.
+ * @param knn_graph Opcional: grafo kNN pré-computado; se presente, substitui a busca LSH.
  */
-std::vector<std::string> generateRecommendationsForUsers(
+void generateRecommendationsForUsers(
     const std::vector<int>& explore_user_ids,
-    const UserItemMatrix& user_item_matrix,
-    const UserNormsMap& user_norms,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
-    const MovieTitlesMap& movie_titles,
+    const std::vector<LSHTable>& lsh_tables,
+    const MovieCatalog& movie_catalog,
     int k_neighbors,
-    int top_n);
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format = RecommendationsOutputFormat::TEXT,
+    const GenreFilter& genre_filter = GenreFilter(),
+    RecommendationCache* cache = nullptr,
+    const SimHashSignatures* signatures = nullptr,
+    const KnnGraph* knn_graph = nullptr);
 
 #endif // RECOMMENDER_ENGINE_HPP
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef RECOMMENDER_MODEL_HPP
+#define RECOMMENDER_MODEL_HPP
+
+/**
+ * @file recommender_model.hpp
+ * @brief Modelo LSH imutável e embutível: matriz, normas, hiperplanos, tabelas, assinaturas, grafo kNN e catálogo.
+ *
+ * O modelo é montado por RecommenderModelBuilder e, depois de pronto, nunca mais é alterado:
+ * todas as consultas são const e reentrantes, então o mesmo modelo pode ser compartilhado
+ * por qualquer número de threads. As consultas gravam em buffers do chamador
+ * (RecommendationQueryResult), que em regime são reaproveitados sem alocação.
+ *
+ * Para trocar o modelo em produção, LiveRecommenderModel guarda um shared_ptr trocado de forma
+ * atômica: cada consulta pega um snapshot e o usa até o fim, enquanto um modelo reconstruído
+ * substitui o antigo sem pausar as consultas (o antigo é liberado quando a última termina).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include "types.hpp"
+#include "config.hpp"
+#include "knn_graph.hpp"
+
+class RecommendationCache; // Definido em recommendation_cache.hpp
+class AsyncFileWriter;     // Definido em output_writer.hpp
+
+// Parâmetros de uma consulta LSH; os padrões reproduzem o processamento em lote.
+struct LSHQueryOptions {
+    int k_neighbors = K_NEIGHBORS;
+    int top_n = TOP_N_RECOMMENDATIONS;
+    float similarity_threshold = 0.1f;
+    bool use_user_mean_filter = true;
+    GenreFilter genre_filter;
+    std::chrono::microseconds deadline = std::chrono::microseconds(QUERY_DEADLINE_MICROSECONDS);
+    size_t max_candidate_evaluations = QUERY_MAX_CANDIDATE_EVALUATIONS;
+};
+
+// Resultado de uma consulta, fornecido pelo chamador e reaproveitado entre consultas.
+struct RecommendationQueryResult {
+    NeighborList neighbors;              // Índices densos dos vizinhos e similaridades
+    RecommendationList recommendations;  // MovieIDs e notas previstas (no máximo top_n)
+    NeighborSimilarityStats neighbor_stats;
+};
+
+class RecommenderModel {
+public:
+    /**
+     * @brief Recomendações LSH para um usuário (ID externo).
+     * @return false se o usuário não existe no modelo (o resultado fica vazio).
+     */
+    bool recommend(int user_id, const LSHQueryOptions& options, RecommendationQueryResult& result) const;
+
+    const RatingMatrix& ratingMatrix() const { return matrix_; }
+    const UserNormsVec& userNorms() const { return user_norms_; }
+    const std::vector<HyperplaneSet>& hyperplaneSets() const { return hyperplane_sets_; }
+    const std::vector<LSHTable>& lshTables() const { return lsh_tables_; }
+    const SimHashSignatures& simHashSignatures() const { return simhash_signatures_; }
+    const KnnGraph& knnGraph() const { return knn_graph_; }
+    const MovieCatalog& movieCatalog() const { return movie_catalog_; }
+
+    // Assinaturas para o pré-filtro SimHash, ou nullptr se não foram calculadas.
+    const SimHashSignatures* simHashSignaturesOrNull() const {
+        return simhash_signatures_.empty() ? nullptr : &simhash_signatures_;
+    }
+
+    // Grafo kNN pré-computado, ou nullptr se não foi construído.
+    const KnnGraph* knnGraphOrNull() const { return knn_graph_.empty() ? nullptr : &knn_graph_; }
+
+private:
+    friend class RecommenderModelBuilder;
+    RecommenderModel() = default;
+
+    RatingMatrix matrix_;
+    UserNormsVec user_norms_;
+    std::vector<HyperplaneSet> hyperplane_sets_;
+    std::vector<LSHTable> lsh_tables_;
+    SimHashSignatures simhash_signatures_;
+    KnnGraph knn_graph_;
+    MovieCatalog movie_catalog_;
+};
+
+/**
+ * @brief Monta um RecommenderModel a partir do log de avaliações filtrado.
+ * @details O log e o conjunto de filmes são apenas referenciados: devem viver até build().
+ * Os padrões vêm de config.hpp.
+ */
+class RecommenderModelBuilder {
+public:
+    RecommenderModelBuilder& setRatings(const UserRatingsLog& users_ratings_log,
+                                        const std::unordered_set<int>& valid_movie_ids);
+    RecommenderModelBuilder& setMovieCatalog(MovieCatalog movie_catalog);
+    RecommenderModelBuilder& setLSHParameters(int num_tables, int num_hyperplanes_per_table, uint32_t seed);
+    RecommenderModelBuilder& setRatingStorage(bool quantize_ratings, bool compress_rows);
+    RecommenderModelBuilder& setBucketStorage(bool compress_buckets); // Listas dos buckets LSH comprimidas
+    RecommenderModelBuilder& setSimHashSignatureBits(int num_bits); // 0 não calcula assinaturas
+    RecommenderModelBuilder& setKnnGraphNeighbors(int k);           // 0 não constrói o grafo kNN
+
+    /**
+     * @return O modelo pronto, ou nullptr se faltarem as avaliações.
+     */
+    std::shared_ptr<const RecommenderModel> build();
+
+private:
+    static void placeModelMemory(RecommenderModel& model, MemoryPlacementPolicy policy, bool huge_pages);
+
+    const UserRatingsLog* users_ratings_log_ = nullptr;
+    const std::unordered_set<int>* valid_movie_ids_ = nullptr;
+    MovieCatalog movie_catalog_;
+    int num_tables_ = NUM_LSH_TABLES;
+    int num_hyperplanes_per_table_ = NUM_HYPERPLANES_PER_TABLE;
+    uint32_t seed_ = 42;
+    bool quantize_ratings_ = QUANTIZE_RATINGS;
+    bool compress_rows_ = COMPRESS_RATING_ROWS;
+    bool compress_buckets_ = COMPRESS_LSH_BUCKETS;
+    int simhash_bits_ = SIMHASH_PREFILTER_ENABLED ? SIMHASH_SIGNATURE_BITS : 0;
+    int knn_graph_k_ = USE_KNN_GRAPH ? K_NEIGHBORS : 0;
+};
+
+/**
+ * @brief Referência ao modelo em uso, trocável atomicamente enquanto há consultas em andamento.
+ */
+class LiveRecommenderModel {
+public:
+    explicit LiveRecommenderModel(std::shared_ptr<const RecommenderModel> initial = nullptr)
+        : current_(std::move(initial)) {}
+
+    // Snapshot estável para uma consulta inteira.
+    std::shared_ptr<const RecommenderModel> snapshot() const {
+        return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+    }
+
+    // Publica um novo modelo e devolve o anterior. Caches indexados por usuário denso
+    // (RecommendationCache) ficam obsoletos e devem ser limpos pelo chamador.
+    std::shared_ptr<const RecommenderModel> swap(std::shared_ptr<const RecommenderModel> next) {
+        return std::atomic_exchange_explicit(&current_, std::move(next), std::memory_order_acq_rel);
+    }
+
+private:
+    std::shared_ptr<const RecommenderModel> current_;
+};
+
+/**
+ * @brief IDs externos de todos os usuários do modelo, em ordem de localidade de bucket LSH.
+ * @details Usuários são ordenados pelos buckets das duas primeiras tabelas: quem compartilha os
+ * dois buckets fica adjacente e é processado em sequência, reaproveitando em cache as linhas dos
+ * candidatos (que são em grande parte os mesmos). Usado pelo job offline de todos os usuários.
+ */
+std::vector<int> bucketLocalityUserOrder(const RecommenderModel& model);
+
+/**
+ * @brief Processamento em lote (explore.dat) sobre um modelo: ver generateRecommendationsForUsers.
+ */
+void generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RecommenderModel& model,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format = RecommendationsOutputFormat::TEXT,
+    const GenreFilter& genre_filter = GenreFilter(),
+    RecommendationCache* cache = nullptr);
+
+#endif // RECOMMENDER_MODEL_HPP
@@ -0,0 +1,100 @@
+#ifndef SHARD_WORKERS_HPP
+#define SHARD_WORKERS_HPP
+
+/**
+ * @file shard_workers.hpp
+ * @brief Modo de escala horizontal local: processos workers, cada um com parte dos shards.
+ *
+ * O coordenador inicia N processos (o próprio executável, em modo worker) ligados a ele por
+ * sockets Unix. O worker w mapeia apenas os shards `s % N == w` do modelo em shards, de modo que
+ * linhas e buckets de cada usuário vivem em um único processo e a banda de memória de cada um é
+ * usada só pelos seus shards. As consultas são enviadas em lotes, em duas rodadas:
+ *  1. o perfil de cada alvo (buckets e linha de avaliações) vai para todos os workers, que
+ *     devolvem o top-K parcial dos seus shards; o coordenador junta o top-K global;
+ *  2. os vizinhos vão para todos os workers, que acumulam as notas dos vizinhos que possuem e
+ *     devolvem as somas por filme; o coordenador soma as parciais e aplica as regras finais.
+ * Tudo roda em uma única máquina Linux, então o mesmo binário serve de coordenador e worker.
+ */
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "types.hpp"
+#include "config.hpp"
+#include "sharded_model.hpp"
+
+class AsyncFileWriter; // Definido em output_writer.hpp
+
+class ShardWorkerPool {
+public:
+    ShardWorkerPool() = default;
+    ~ShardWorkerPool() { stop(); }
+    ShardWorkerPool(const ShardWorkerPool&) = delete;
+    ShardWorkerPool& operator=(const ShardWorkerPool&) = delete;
+
+    /**
+     * @brief Inicia `num_workers` processos sobre o diretório de shards e espera cada um abrir os seus.
+     * @return false se algum worker não puder ser criado ou não abrir os shards.
+     */
+    bool start(const std::string& directory, int num_workers);
+
+    // Fecha os sockets (os workers terminam ao ver o fim do fluxo) e espera os processos.
+    void stop();
+
+    int numWorkers() const { return static_cast<int>(workers_.size()); }
+
+    /**
+     * @brief Top-K global de cada perfil, a partir dos top-K parciais dos workers.
+     * @details Perfis com user_idx < 0 recebem listas vazias.
+     */
+    bool findNeighbors(const std::vector<ShardedTargetProfile>& profiles, int K,
+                       std::vector<NeighborList>& neighbors);
+
+    /**
+     * @brief Contribuições dos vizinhos de cada perfil, concatenadas na ordem dos workers
+     * (um mesmo filme pode aparecer uma vez por worker).
+     */
+    bool accumulateScores(const std::vector<ShardedTargetProfile>& profiles,
+                          const std::vector<NeighborList>& neighbors, float similarity_threshold,
+                          const GenreFilter& genre_filter, std::vector<std::vector<MovieScorePartial>>& partials);
+
+private:
+    struct Worker {
+        pid_t pid = -1;
+        int socket = -1;
+    };
+
+    bool broadcast(uint32_t type, uint32_t count, const std::string& payload);
+
+    std::vector<Worker> workers_;
+};
+
+/**
+ * @brief Indica se o executável foi iniciado como worker por um ShardWorkerPool.
+ */
+bool isShardWorkerInvocation(int argc, char* argv[]);
+
+/**
+ * @brief Laço do processo worker: atende as requisições do coordenador até o socket ser fechado.
+ * @return Código de saída do processo.
+ */
+int runShardWorker(int argc, char* argv[]);
+
+/**
+ * @brief Processamento em lote (explore.dat) com os workers; mesma saída de
+ * generateRecommendationsForUsers, a menos da ordem das somas de ponto flutuante entre workers.
+ * @param model Modelo em shards do coordenador (perfis dos alvos, IDs e catálogo de filmes).
+ * @return false se a comunicação com algum worker falhar.
+ */
+bool generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const ShardedModel& model,
+    ShardWorkerPool& workers,
+    const MovieCatalog& movie_catalog,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format = RecommendationsOutputFormat::TEXT,
+    const GenreFilter& genre_filter = GenreFilter());
+
+#endif // SHARD_WORKERS_HPP
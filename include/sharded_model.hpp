@@ -0,0 +1,185 @@
+#ifndef SHARDED_MODEL_HPP
+#define SHARDED_MODEL_HPP
+
+/**
+ * @file sharded_model.hpp
+ * @brief Modelo LSH fora da memória: usuários particionados em shards em disco, lidos via mmap.
+ *
+ * Cada shard guarda um intervalo contíguo de usuários (índices densos) com tudo que as consultas
+ * leem deles: linhas de avaliações, normas, o bucket de cada usuário em cada tabela e o segmento
+ * de cada bucket com os seus membros. Os arquivos são mapeados com mmap e paginados sob demanda
+ * (MADV_RANDOM: cada falta de página traz só a página tocada). Em memória ficam apenas o diretório
+ * (IDs, gêneros e a ocupação de cada bucket em cada shard), de modo que a base de usuários pode
+ * ser várias vezes maior que a RAM.
+ *
+ * O planejador de consultas usa a ocupação dos buckets para visitar apenas os shards que têm
+ * candidatos do alvo em alguma tabela. Vizinhos e recomendações seguem as mesmas regras de
+ * findApproximateKNearestNeighborsLSH e generateRecommendationsLSH (sem pré-filtros nem orçamento),
+ * sempre com o cosseno: os shards guardam apenas as normas dos usuários.
+ */
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "types.hpp"
+#include "config.hpp"
+
+class RecommenderModel; // Definido em recommender_model.hpp
+class AsyncFileWriter;  // Definido em output_writer.hpp
+
+/**
+ * @brief Grava o modelo em `num_shards` shards no diretório (criado se não existir).
+ * @details Os shards são montados e gravados um de cada vez, então a memória extra é a de um shard.
+ * @return true em caso de sucesso.
+ */
+bool writeShardedModel(const RecommenderModel& model, const std::string& directory, int num_shards);
+
+// Contadores do planejador: quantos shards as consultas precisaram visitar.
+struct ShardedQueryStats {
+    uint64_t queries = 0;
+    uint64_t shards_touched = 0;
+
+    double averageShardsTouched() const { return queries ? static_cast<double>(shards_touched) / queries : 0.0; }
+};
+
+/**
+ * @brief Perfil do usuário alvo: tudo que um shard precisa para avaliar candidatos e acumular
+ * notas, inclusive em outro processo (ver shard_workers.hpp).
+ */
+struct ShardedTargetProfile {
+    int user_idx = -1;
+    float norm = 0.0f;
+    std::vector<uint32_t> buckets;     // Bucket do alvo em cada tabela
+    std::vector<int> movies;           // Índices densos dos filmes avaliados
+    std::vector<uint8_t> rating_units; // Notas quantizadas (modelo quantizado)
+    std::vector<float> ratings;        // Notas em float (modelo em float)
+};
+
+// Contribuição dos vizinhos de um shard (ou de um worker) para um filme.
+struct MovieScorePartial {
+    int movie_idx;
+    float weighted_score_sum;
+    float similarity_sum;
+};
+
+class ShardedModel {
+public:
+    ShardedModel() = default;
+    ~ShardedModel() { close(); }
+    ShardedModel(const ShardedModel&) = delete;
+    ShardedModel& operator=(const ShardedModel&) = delete;
+
+    /**
+     * @brief Lê o diretório e mapeia os shards (nada é carregado além do diretório).
+     * @details Com `num_workers` > 1 apenas os shards `s` com `s % num_workers == worker` são
+     * mapeados; as consultas consideram somente os usuários desses shards.
+     * @return false se algum arquivo estiver ausente ou inconsistente.
+     */
+    bool open(const std::string& directory, int worker = 0, int num_workers = 1);
+    void close();
+
+    bool isOpen() const { return !shards_.empty(); }
+    int numShards() const { return static_cast<int>(shards_.size()); }
+    int numUsers() const { return users_.size(); }
+    int numMovies() const { return movies_.size(); }
+    bool isQuantized() const { return quantized_; }
+    int toDenseUser(int user_id) const { return users_.toDense(user_id); }
+    int shardIndexOf(int user_idx) const;
+    bool isShardMapped(int shard) const { return shards_[shard].mapping != nullptr; }
+
+    /**
+     * @brief K vizinhos mais similares do usuário (índice denso), em similaridade decrescente.
+     */
+    void findNeighbors(int target_user_idx, int K, NeighborList& neighbors) const;
+
+    /**
+     * @brief Recomendações (índices densos dos filmes) a partir dos vizinhos, em nota decrescente.
+     */
+    void recommend(int target_user_idx, const NeighborList& neighbors, float similarity_threshold,
+                   bool use_user_mean_filter, const GenreFilter& genre_filter,
+                   RecommendationList& recommendations) const;
+
+    /**
+     * @brief Copia o perfil do alvo do seu shard.
+     * @return false se o índice for inválido ou o shard do alvo não estiver mapeado.
+     */
+    bool loadTargetProfile(int target_user_idx, ShardedTargetProfile& profile) const;
+
+    /**
+     * @brief Top-K parcial: candidatos dos buckets do alvo nos shards mapeados, em similaridade decrescente.
+     */
+    void scoreCandidates(const ShardedTargetProfile& profile, int K, NeighborList& neighbors) const;
+
+    /**
+     * @brief Acumula as notas dos vizinhos que estão nos shards mapeados (os demais são ignorados),
+     * na ordem da lista. Filmes já avaliados pelo alvo e rejeitados pelo filtro de gêneros ficam de fora.
+     */
+    void accumulateScores(const ShardedTargetProfile& profile, const NeighborList& neighbors,
+                          float similarity_threshold, const GenreFilter& genre_filter,
+                          std::vector<MovieScorePartial>& partials) const;
+
+    /**
+     * @brief Regras finais de generateRecommendationsLSH sobre as contribuições já somadas
+     * (uma por filme): soma de similaridades > 1, filtro pela média do alvo e fallback.
+     */
+    static void finishRecommendations(const ShardedTargetProfile& profile,
+                                      const std::vector<MovieScorePartial>& partials,
+                                      bool use_user_mean_filter, RecommendationList& recommendations);
+
+    // Converte para MovieIDs e mantém as top_n primeiras (ver restoreExternalMovieIds).
+    void restoreExternalMovieIds(RecommendationList& recommendations, int top_n) const;
+
+    ShardedQueryStats stats() const;
+
+private:
+    // Visão de um shard mapeado: ponteiros para dentro do mmap.
+    struct Shard {
+        void* mapping = nullptr;                 // nullptr: shard de outro worker
+        size_t mapping_size = 0;
+        uint32_t first_user = 0;
+        uint32_t num_users = 0;
+        const uint32_t* row_offsets = nullptr;   // num_users + 1, relativos ao shard
+        const int32_t* row_movies = nullptr;
+        const uint8_t* row_rating_units = nullptr; // Matriz quantizada
+        const float* row_ratings = nullptr;        // Matriz em float
+        const float* norms = nullptr;
+        const uint32_t* user_buckets = nullptr;    // [tabela][usuário local]
+        const uint32_t* bucket_offsets = nullptr;  // [tabela][bucket + 1]
+        const int32_t* bucket_users = nullptr;     // [tabela][posição], índices densos globais
+    };
+
+    const Shard& shardOf(int user_idx) const { return shards_[shardIndexOf(user_idx)]; }
+    float ratingAt(const Shard& shard, uint32_t p) const {
+        return quantized_ ? shard.row_rating_units[p] * RATING_UNIT : shard.row_ratings[p];
+    }
+
+    DenseIdMap users_;
+    DenseIdMap movies_;
+    std::vector<GenreMask> movie_genres_;
+    std::vector<uint32_t> shard_first_user_; // numShards() + 1
+    std::vector<uint32_t> bucket_counts_;    // [shard][tabela][bucket]: membros do bucket no shard
+    int num_tables_ = 0;
+    uint32_t num_buckets_ = 0;
+    bool quantized_ = false;
+    std::vector<Shard> shards_;
+
+    mutable std::atomic<uint64_t> queries_{0};
+    mutable std::atomic<uint64_t> shards_touched_{0};
+};
+
+/**
+ * @brief Processamento em lote (explore.dat) sobre o modelo em shards; mesma saída de
+ * generateRecommendationsForUsers.
+ */
+void generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const ShardedModel& model,
+    const MovieCatalog& movie_catalog,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format = RecommendationsOutputFormat::TEXT,
+    const GenreFilter& genre_filter = GenreFilter());
+
+#endif // SHARDED_MODEL_HPP
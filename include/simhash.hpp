@@ -0,0 +1,87 @@
+#ifndef SIMHASH_HPP
+#define SIMHASH_HPP
+
+/**
+ * @file simhash.hpp
+ * @brief Assinaturas SimHash longas (256 a 1024 bits) e distância de Hamming por popcount.
+ *
+ * Cada filme recebe um vetor pseudoaleatório de sinais (+1/-1) por bit; o bit i da assinatura
+ * de um usuário é o sinal da soma das notas ponderadas pelo sinal i de cada filme avaliado.
+ * A fração de bits diferentes entre dois usuários estima o ângulo entre as linhas:
+ * cos(pi * hamming / bits). A comparação usa só XOR + popcount sobre palavras contíguas, sem
+ * tocar nas linhas de avaliações — um filtro barato antes do cosseno exato.
+ */
+
+#include <cstdint>
+#include <cmath>
+#include "types.hpp"
+
+#if defined(__AVX512VPOPCNTDQ__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+constexpr float SIMHASH_PI = 3.14159265358979323846f;
+
+/**
+ * @brief Calcula a assinatura SimHash de todos os usuários.
+ * @param num_bits Bits por assinatura, arredondado para múltiplo de 64 (<= 0 devolve assinaturas vazias).
+ * @param seed Semente dos sinais pseudoaleatórios dos filmes.
+ */
+SimHashSignatures buildSimHashSignatures(const RatingMatrix& matrix, int num_bits, uint64_t seed);
+
+/**
+ * @brief Número de bits diferentes entre duas assinaturas de `num_words` palavras.
+ */
+inline uint32_t simHashHammingDistance(const uint64_t* a, const uint64_t* b, int num_words) {
+    uint32_t distance = 0;
+    int w = 0;
+#if defined(__AVX512VPOPCNTDQ__)
+    // 8 palavras por vez com VPOPCNTQ.
+    __m512i counts = _mm512_setzero_si512();
+    for (; w + 8 <= num_words; w += 8) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + w), _mm512_loadu_si512(b + w));
+        counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(x));
+    }
+    distance += static_cast<uint32_t>(_mm512_reduce_add_epi64(counts));
+#elif defined(__AVX2__)
+    // 4 palavras por vez: popcount de cada nibble por tabela (pshufb) e soma por _mm256_sad_epu8.
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i counts = _mm256_setzero_si256();
+    for (; w + 4 <= num_words; w += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w)));
+        __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+        __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+        counts = _mm256_add_epi64(counts, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), counts);
+    distance += static_cast<uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+    for (; w < num_words; ++w) {
+        distance += static_cast<uint32_t>(__builtin_popcountll(a[w] ^ b[w]));
+    }
+    return distance;
+}
+
+/**
+ * @brief Similaridade de cosseno estimada a partir da distância de Hamming.
+ */
+inline float simHashEstimatedCosine(uint32_t hamming_distance, int num_bits) {
+    return std::cos(SIMHASH_PI * static_cast<float>(hamming_distance) / static_cast<float>(num_bits));
+}
+
+/**
+ * @brief Maior distância de Hamming cuja similaridade estimada ainda é >= `min_similarity`.
+ * @details Permite filtrar comparando inteiros, sem calcular cossenos por candidato.
+ */
+inline uint32_t simHashMaxDistanceForSimilarity(float min_similarity, int num_bits) {
+    if (min_similarity <= -1.0f) return static_cast<uint32_t>(num_bits);
+    if (min_similarity >= 1.0f) return 0;
+    const float angle_fraction = std::acos(min_similarity) / SIMHASH_PI;
+    return static_cast<uint32_t>(std::floor(angle_fraction * static_cast<float>(num_bits)));
+}
+
+#endif // SIMHASH_HPP
@@ -0,0 +1,226 @@
+#ifndef SIMILARITY_POLICIES_HPP
+#define SIMILARITY_POLICIES_HPP
+
+/**
+ * @file similarity_policies.hpp
+ * @brief Métricas de similaridade entre usuários como políticas de tempo de compilação.
+ *
+ * Cada política descreve quais somas sobre os filmes avaliados pelos dois usuários ela precisa e
+ * como combiná-las com os termos pré-calculados de cada usuário (norma, média, norma centrada,
+ * tamanho da linha). Os kernels abaixo são templates na política: o compilador gera um laço
+ * especializado por métrica, que acumula só as somas usadas, sem nenhum desvio por par.
+ *
+ * A métrica em uso é SIMILARITY_METRIC (config.hpp), resolvida para um tipo em
+ * ConfiguredSimilarity; os laços de busca de vizinhos chamam os kernels com esse tipo.
+ *   - CosineSimilarity: delega aos kernels de produto interno de sparse_dot.hpp.
+ *   - AdjustedCosineSimilarity: notas centradas na média de cada usuário; o numerador vem dos
+ *     filmes em comum e o denominador das normas centradas das linhas inteiras.
+ *   - PearsonSimilarity: mesmo numerador, com as variâncias restritas aos filmes em comum.
+ *   - JaccardSimilarity: só a contagem de filmes em comum e os tamanhos das linhas.
+ * Com notas quantizadas todas as somas são inteiras (meias estrelas) e, portanto, exatas.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "types.hpp"
+#include "config.hpp"
+#include "sparse_dot.hpp"
+#include "compressed_rows.hpp"
+
+// Somas sobre os filmes avaliados pelos dois usuários, na unidade do acumulador.
+template <typename AccT>
+struct CoRatedSums {
+    AccT count = 0;
+    AccT sum_a = 0, sum_b = 0;   // Σ ra, Σ rb
+    AccT sum_ab = 0;             // Σ ra·rb
+    AccT sum_aa = 0, sum_bb = 0; // Σ ra², Σ rb²
+};
+
+// As mesmas somas na escala das notas, em double para a combinação final.
+struct CoRatedStats {
+    double count, sum_a, sum_b, sum_ab, sum_aa, sum_bb;
+};
+
+template <typename AccT>
+inline CoRatedStats scaleCoRatedSums(const CoRatedSums<AccT>& sums, double unit) {
+    const double unit_sq = unit * unit;
+    return {static_cast<double>(sums.count),
+            sums.sum_a * unit, sums.sum_b * unit,
+            sums.sum_ab * unit_sq, sums.sum_aa * unit_sq, sums.sum_bb * unit_sq};
+}
+
+// Numerador comum das métricas centradas: Σ (ra - ma)(rb - mb) sobre os filmes em comum.
+inline double centeredCoRatedDot(const CoRatedStats& s, double mean_a, double mean_b) {
+    return s.sum_ab - mean_b * s.sum_a - mean_a * s.sum_b + s.count * mean_a * mean_b;
+}
+
+struct CosineSimilarity {
+    static constexpr bool uses_dot_kernels = true;
+    static constexpr bool needs_user_means = false;
+
+    static float fromDot(float dot_product, float norm_a, float norm_b) {
+        return dot_product / (norm_a * norm_b);
+    }
+};
+
+struct AdjustedCosineSimilarity {
+    static constexpr bool uses_dot_kernels = false;
+    static constexpr bool needs_user_means = true;
+    static constexpr bool needs_products = true;
+    static constexpr bool needs_squares = false;
+
+    static float finish(const CoRatedStats& s, const RatingMatrix& matrix, const UserNormsVec&, int a, int b) {
+        const double denominator = static_cast<double>(matrix.user_centered_norms[a]) * matrix.user_centered_norms[b];
+        if (denominator == 0.0 || s.count == 0.0) return 0.0f;
+        return static_cast<float>(centeredCoRatedDot(s, matrix.user_means[a], matrix.user_means[b]) / denominator);
+    }
+};
+
+struct PearsonSimilarity {
+    static constexpr bool uses_dot_kernels = false;
+    static constexpr bool needs_user_means = true;
+    static constexpr bool needs_products = true;
+    static constexpr bool needs_squares = true;
+
+    static float finish(const CoRatedStats& s, const RatingMatrix& matrix, const UserNormsVec&, int a, int b) {
+        if (s.count == 0.0) return 0.0f;
+        const double mean_a = matrix.user_means[a], mean_b = matrix.user_means[b];
+        const double variance_a = s.sum_aa - 2.0 * mean_a * s.sum_a + s.count * mean_a * mean_a;
+        const double variance_b = s.sum_bb - 2.0 * mean_b * s.sum_b + s.count * mean_b * mean_b;
+        if (variance_a <= 0.0 || variance_b <= 0.0) return 0.0f;
+        return static_cast<float>(centeredCoRatedDot(s, mean_a, mean_b) / std::sqrt(variance_a * variance_b));
+    }
+};
+
+struct JaccardSimilarity {
+    static constexpr bool uses_dot_kernels = false;
+    static constexpr bool needs_user_means = false;
+    static constexpr bool needs_products = false;
+    static constexpr bool needs_squares = false;
+
+    static float finish(const CoRatedStats& s, const RatingMatrix& matrix, const UserNormsVec&, int a, int b) {
+        const double union_size = static_cast<double>(matrix.rowLength(a)) + matrix.rowLength(b) - s.count;
+        return union_size > 0.0 ? static_cast<float>(s.count / union_size) : 0.0f;
+    }
+};
+
+template <SimilarityMetric Metric> struct SimilarityPolicyFor;
+template <> struct SimilarityPolicyFor<SimilarityMetric::COSINE> { using type = CosineSimilarity; };
+template <> struct SimilarityPolicyFor<SimilarityMetric::ADJUSTED_COSINE> { using type = AdjustedCosineSimilarity; };
+template <> struct SimilarityPolicyFor<SimilarityMetric::PEARSON> { using type = PearsonSimilarity; };
+template <> struct SimilarityPolicyFor<SimilarityMetric::JACCARD> { using type = JaccardSimilarity; };
+
+// Política da métrica configurada em SIMILARITY_METRIC.
+using ConfiguredSimilarity = SimilarityPolicyFor<SIMILARITY_METRIC>::type;
+
+/**
+ * @brief Calcula as médias e normas centradas de todos os usuários (`matrix.user_means` e
+ * `matrix.user_centered_norms`), usadas pelas métricas centradas.
+ */
+void attachUserSimilarityTerms(RatingMatrix& matrix);
+
+template <typename Policy, typename AccT>
+inline void addCoRated(CoRatedSums<AccT>& sums, AccT a, AccT b) {
+    ++sums.count;
+    if constexpr (Policy::needs_products) {
+        sums.sum_a += a;
+        sums.sum_b += b;
+        sums.sum_ab += a * b;
+    }
+    if constexpr (Policy::needs_squares) {
+        sums.sum_aa += a * a;
+        sums.sum_bb += b * b;
+    }
+}
+
+// `dense` é a linha do alvo espalhada por índice; zero marca filme não avaliado (notas >= 0.5).
+template <typename Policy, typename RatingT, typename AccT>
+inline CoRatedSums<AccT> coRatedSumsDense(const RatingT* dense, const int* idx, const RatingT* val, uint32_t len) {
+    CoRatedSums<AccT> sums;
+    for (uint32_t i = 0; i < len; ++i) {
+        const RatingT a = dense[idx[i]];
+        if (a == 0) continue;
+        addCoRated<Policy>(sums, static_cast<AccT>(a), static_cast<AccT>(val[i]));
+    }
+    return sums;
+}
+
+template <typename Policy, typename RatingT, typename AccT>
+inline CoRatedSums<AccT> coRatedSumsMerge(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                                          const int* idx_b, const RatingT* val_b, uint32_t len_b) {
+    CoRatedSums<AccT> sums;
+    uint32_t a = 0, b = 0;
+    while (a < len_a && b < len_b) {
+        if (idx_a[a] < idx_b[b]) {
+            ++a;
+        } else if (idx_b[b] < idx_a[a]) {
+            ++b;
+        } else {
+            addCoRated<Policy>(sums, static_cast<AccT>(val_a[a]), static_cast<AccT>(val_b[b]));
+            ++a;
+            ++b;
+        }
+    }
+    return sums;
+}
+
+/**
+ * @brief Similaridade entre o alvo carregado em `target` e o usuário `other_user`.
+ * @details As políticas que não usam o produto interno exigem a linha do alvo espalhada
+ * (`load` com build_dense).
+ */
+template <typename Policy>
+inline float targetSimilarity(const RatingMatrix& matrix, const UserNormsVec& user_norms,
+                              const QueryRowContext& target, int other_user) {
+    const int target_user = target.userIdx();
+    if constexpr (Policy::uses_dot_kernels) {
+        const float target_norm = user_norms[target_user], other_norm = user_norms[other_user];
+        if (target_norm == 0.0f || other_norm == 0.0f) return 0.0f;
+        return Policy::fromDot(target.dot(matrix, other_user), target_norm, other_norm);
+    } else {
+        thread_local std::vector<int> other_scratch;
+        const uint32_t len = matrix.rowLength(other_user);
+        const int* movies = rowMovieIndices(matrix, other_user, other_scratch);
+        const uint32_t begin = matrix.rowBegin(other_user);
+        const CoRatedStats stats = matrix.isQuantized()
+            ? scaleCoRatedSums(coRatedSumsDense<Policy, uint8_t, uint32_t>(
+                  target.denseUnits(), movies, matrix.row_rating_units.data() + begin, len), RATING_UNIT)
+            : scaleCoRatedSums(coRatedSumsDense<Policy, float, float>(
+                  target.denseRatings(), movies, matrix.row_ratings.data() + begin, len), 1.0);
+        return Policy::finish(stats, matrix, user_norms, target_user, other_user);
+    }
+}
+
+/**
+ * @brief Similaridade entre dois usuários quaisquer (interseção das linhas ordenadas).
+ */
+template <typename Policy>
+inline float pairSimilarity(const RatingMatrix& matrix, const UserNormsVec& user_norms, int user_a, int user_b) {
+    if constexpr (Policy::uses_dot_kernels) {
+        const float norm_a = user_norms[user_a], norm_b = user_norms[user_b];
+        if (norm_a == 0.0f || norm_b == 0.0f) return 0.0f;
+        const float dot_product = sparseRowDot(matrix, user_a, user_b);
+        if (dot_product == 0.0f) return 0.0f;
+        return Policy::fromDot(dot_product, norm_a, norm_b);
+    } else {
+        thread_local std::vector<int> scratch_a, scratch_b;
+        const uint32_t len_a = matrix.rowLength(user_a), len_b = matrix.rowLength(user_b);
+        const int* movies_a = rowMovieIndices(matrix, user_a, scratch_a);
+        const int* movies_b = rowMovieIndices(matrix, user_b, scratch_b);
+        const uint32_t begin_a = matrix.rowBegin(user_a), begin_b = matrix.rowBegin(user_b);
+        CoRatedStats stats;
+        if (matrix.isQuantized()) {
+            const uint8_t* units = matrix.row_rating_units.data();
+            stats = scaleCoRatedSums(coRatedSumsMerge<Policy, uint8_t, uint32_t>(
+                movies_a, units + begin_a, len_a, movies_b, units + begin_b, len_b), RATING_UNIT);
+        } else {
+            const float* ratings = matrix.row_ratings.data();
+            stats = scaleCoRatedSums(coRatedSumsMerge<Policy, float, float>(
+                movies_a, ratings + begin_a, len_a, movies_b, ratings + begin_b, len_b), 1.0);
+        }
+        return Policy::finish(stats, matrix, user_norms, user_a, user_b);
+    }
+}
+
+#endif // SIMILARITY_POLICIES_HPP
@@ -0,0 +1,109 @@
+#ifndef SPARSE_DOT_HPP
+#define SPARSE_DOT_HPP
+
+/**
+ * @file sparse_dot.hpp
+ * @brief Kernels de produto interno esparso sobre linhas com índices ordenados.
+ *
+ * O produto interno de duas linhas da matriz de avaliações é a soma dos produtos das notas na
+ * interseção dos índices de filmes. Há várias formas de calcular essa interseção, cada uma
+ * melhor em um regime:
+ *   - MERGE: percorre as duas listas em paralelo; O(|a| + |b|), mas com desvios imprevisíveis.
+ *   - SIMD_BLOCK: compara blocos de 8 (AVX2) ou 4 (SSE2) índices contra blocos do outro lado
+ *     com rotações, todos-contra-todos; ótimo para listas de tamanhos parecidos.
+ *   - GALLOPING: para cada índice da lista curta faz busca exponencial na longa;
+ *     O(|curta| * log(|longa| / |curta|)), ótimo quando os tamanhos são muito diferentes.
+ *   - DENSE_SCATTER: espalha a linha do alvo em um vetor denso uma única vez por consulta e
+ *     depois cada candidato custa um acesso direto por avaliação (O(|candidato|)).
+ * O kernel é escolhido em tempo de execução pela razão entre os tamanhos das linhas e pelos
+ * recursos da CPU (AVX2 detectado em tempo de execução).
+ *
+ * Com notas quantizadas (uint8_t) a acumulação é inteira e todos os kernels dão exatamente o
+ * mesmo resultado.
+ */
+
+#include <cstdint>
+#include <vector>
+#include "types.hpp"
+
+enum class SparseDotKernel {
+    MERGE,
+    SIMD_BLOCK,
+    GALLOPING,
+    DENSE_SCATTER
+};
+
+// Kernels sobre arrays ordenados de índices e suas notas. Instanciados para
+// (uint8_t, uint32_t) — notas em meias estrelas — e (float, float).
+template <typename RatingT, typename AccT>
+AccT sparseDotMerge(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                    const int* idx_b, const RatingT* val_b, uint32_t len_b);
+
+template <typename RatingT, typename AccT>
+AccT sparseDotSimdBlock(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                        const int* idx_b, const RatingT* val_b, uint32_t len_b);
+
+// `idx_a` deve ser a lista curta.
+template <typename RatingT, typename AccT>
+AccT sparseDotGalloping(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                        const int* idx_b, const RatingT* val_b, uint32_t len_b);
+
+// `dense` é a outra linha espalhada por índice (zero nos filmes não avaliados).
+template <typename RatingT, typename AccT>
+AccT sparseDotDense(const RatingT* dense, const int* idx, const RatingT* val, uint32_t len);
+
+/**
+ * @brief true se a CPU em execução suporta o kernel SIMD de 8 posições (AVX2).
+ */
+bool sparseDotHasAvx2();
+
+/**
+ * @brief Escolhe o kernel para um par de linhas.
+ * @param len_target Tamanho da linha do alvo.
+ * @param len_other Tamanho da outra linha.
+ * @param dense_target_available Se a linha do alvo já está espalhada em um vetor denso.
+ */
+SparseDotKernel selectSparseDotKernel(uint32_t len_target, uint32_t len_other, bool dense_target_available);
+
+/**
+ * @brief Linha de um usuário alvo preparada para muitos produtos internos na mesma consulta.
+ * @details Os índices são decodificados uma única vez (se a matriz for comprimida) e as notas
+ * são espalhadas em um vetor denso reutilizado. Depois de `load`, `dot` pode ser chamado por
+ * várias threads ao mesmo tempo (somente leitura); cada thread usa o próprio buffer para
+ * decodificar as linhas dos candidatos.
+ */
+class QueryRowContext {
+public:
+    /**
+     * @param build_dense Se true, espalha a linha em um vetor denso (kernel DENSE_SCATTER).
+     */
+    void load(const RatingMatrix& matrix, int user_idx, bool build_dense);
+
+    /**
+     * @brief Produto interno (na escala das notas) entre a linha carregada e a do usuário `other_user`.
+     */
+    float dot(const RatingMatrix& matrix, int other_user) const;
+
+    int userIdx() const { return user_idx_; }
+    bool hasDense() const { return has_dense_; }
+    // Linha espalhada (só com build_dense): zero nos filmes que o alvo não avaliou.
+    const uint8_t* denseUnits() const { return dense_units_.data(); }
+    const float* denseRatings() const { return dense_ratings_.data(); }
+
+private:
+    template <typename RatingT, typename AccT>
+    AccT dotImpl(const RatingMatrix& matrix, const RatingT* ratings, const RatingT* dense, int other_user) const;
+
+    int user_idx_ = -1;
+    bool has_dense_ = false;
+    std::vector<int> movies_;           // Índices decodificados do alvo (também as posições a zerar no próximo load)
+    std::vector<uint8_t> dense_units_;  // Notas espalhadas (matriz quantizada)
+    std::vector<float> dense_ratings_;  // Notas espalhadas (matriz em float)
+};
+
+/**
+ * @brief Produto interno (na escala das notas) entre duas linhas, com o kernel escolhido em tempo de execução.
+ */
+float sparseRowDot(const RatingMatrix& matrix, int user_a, int user_b);
+
+#endif // SPARSE_DOT_HPP
@@ -2,41 +2,240 @@
 #define TYPES_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
+#include <memory_resource> // Para os logs de avaliações em arenas
 #include <utility> // Para std::pair
 #include <cstdint> // Para uint64_t
+#include <cstdlib> // Para std::aligned_alloc
+#include <new>     // Para std::bad_alloc
+#include <chrono>  // Para QueryBudget
 
-// Alias de tipo para dados brutos de avaliação do usuário: UserID -> vetor de pares (MovieID, Rating)
-using UserRatingsLog = std::unordered_map<int, std::vector<std::pair<int, float>>>;
+// Alias de tipo para dados brutos de avaliação do usuário: UserID -> vetor de pares (MovieID, Rating).
+// Os contêineres são std::pmr: construído sobre uma arena (std::pmr::monotonic_buffer_resource),
+// o log inteiro (nós, buckets e linhas) fica em poucos blocos grandes, liberados de uma vez com a
+// arena; sem recurso explícito usa new/delete.
+using UserRatings = std::pmr::vector<std::pair<int, float>>;
+using UserRatingsLog = std::pmr::unordered_map<int, UserRatings>;
 
-// Alias de tipo para nomes de filmes: MovieID -> MovieTitle
-using MovieTitlesMap = std::unordered_map<int, std::string>;
+// Máscara de gêneros de um filme: bit i ligado <=> o filme pertence a MOVIE_GENRE_NAMES[i]
+using GenreMask = uint32_t;
 
-// Alias de tipo para matriz de avaliação usuário-item: UserID -> (MovieID -> Rating)
-using UserItemMatrix = std::unordered_map<int, std::unordered_map<int, float>>;
+// Gêneros do MovieLens, na ordem dos bits de GenreMask
+inline constexpr std::string_view MOVIE_GENRE_NAMES[] = {
+    "Action", "Adventure", "Animation", "Children", "Comedy", "Crime", "Documentary",
+    "Drama", "Fantasy", "Film-Noir", "Horror", "IMAX", "Musical", "Mystery", "Romance",
+    "Sci-Fi", "Thriller", "War", "Western", "(no genres listed)"
+};
+inline constexpr int NUM_MOVIE_GENRES = sizeof(MOVIE_GENRE_NAMES) / sizeof(MOVIE_GENRE_NAMES[0]);
+static_assert(NUM_MOVIE_GENRES <= 32, "GenreMask tem apenas 32 bits");
 
-// Alias de tipo para normas de usuário: UserID -> Norma L2 do vetor de avaliações
-using UserNormsMap = std::unordered_map<int, float>;
+// Restrição de gêneros de uma consulta de recomendação.
+// include_mask: se não for zero, o filme precisa ter pelo menos um desses gêneros ("top N em Comédia").
+// exclude_mask: o filme não pode ter nenhum desses gêneros ("excluir Terror").
+struct GenreFilter {
+    GenreMask include_mask = 0;
+    GenreMask exclude_mask = 0;
 
-// Alias de tipo para uma lista de vizinhos: Vetor de pares (UserID, SimilarityScore)
+    bool isActive() const { return include_mask != 0 || exclude_mask != 0; }
+    bool accepts(GenreMask movie_genres) const {
+        return (include_mask == 0 || (movie_genres & include_mask) != 0) && (movie_genres & exclude_mask) == 0;
+    }
+};
+
+// Posição de um título dentro da arena de títulos do catálogo
+struct MovieTitleRecord {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Catálogo compacto de filmes: todos os títulos em uma única arena de caracteres,
+// com registros (offset, comprimento) e máscaras de gêneros indexados pelo índice do catálogo
+// (ordem do arquivo movies.csv). A busca MovieID -> índice é um acesso direto a vetor.
+struct MovieCatalog {
+    std::string title_arena;
+    std::vector<MovieTitleRecord> titles;  // Índice do catálogo -> posição do título
+    std::vector<GenreMask> genre_masks;    // Índice do catálogo -> gêneros
+    std::vector<int> movie_ids;            // Índice do catálogo -> MovieID
+    std::vector<int> index_of_movie;       // MovieID -> índice do catálogo (-1 se ausente)
+
+    size_t size() const { return movie_ids.size(); }
+
+    int indexOf(int movie_id) const {
+        if (movie_id < 0 || static_cast<size_t>(movie_id) >= index_of_movie.size()) return -1;
+        return index_of_movie[movie_id];
+    }
+    std::string_view titleAt(int catalog_idx) const {
+        const MovieTitleRecord& record = titles[catalog_idx];
+        return std::string_view(title_arena.data() + record.offset, record.length);
+    }
+    // Retorna false se o filme não está no catálogo.
+    bool findTitle(int movie_id, std::string_view& out_title) const {
+        int idx = indexOf(movie_id);
+        if (idx < 0) return false;
+        out_title = titleAt(idx);
+        return true;
+    }
+    GenreMask genresOf(int movie_id) const {
+        int idx = indexOf(movie_id);
+        return idx < 0 ? 0 : genre_masks[idx];
+    }
+};
+
+// Camada de mapeamento de IDs: IDs externos (esparsos, como vêm do CSV) <-> índices densos (0 a N-1).
+// Construída uma vez na ingestão; todo o restante do motor trabalha só com índices densos e
+// os IDs externos são restaurados apenas na entrada (explore.dat) e na saída.
+struct DenseIdMap {
+    std::vector<int> dense_to_external;  // Índice denso -> ID externo
+    std::vector<int> external_to_dense;  // ID externo -> índice denso (-1 se ausente)
+
+    int size() const { return static_cast<int>(dense_to_external.size()); }
+
+    int toDense(int external_id) const {
+        if (external_id < 0 || static_cast<size_t>(external_id) >= external_to_dense.size()) return -1;
+        return external_to_dense[external_id];
+    }
+    int toExternal(int dense_idx) const { return dense_to_external[dense_idx]; }
+};
+
+// As notas do MovieLens são múltiplos de meia estrela (0.5 a 5.0): na forma quantizada cada nota
+// é guardada como um uint8_t em "meias estrelas" (nota = unidades * RATING_UNIT).
+constexpr float RATING_UNIT = 0.5f;
+
+// Matriz de avaliações usuário-item em formato CSR, indexada por índices densos.
+// A linha do usuário u ocupa [row_offsets[u], row_offsets[u + 1]) de `row_movies` e das notas,
+// com os índices densos dos filmes em ordem crescente. As notas ficam em `row_ratings` (float)
+// ou, na forma quantizada, apenas em `row_rating_units` (1 byte por nota). Na forma comprimida
+// os índices dos filmes ficam apenas em `row_movie_bytes` (ver compressed_rows.hpp).
+struct RatingMatrix {
+    DenseIdMap users;
+    DenseIdMap movies;
+    std::vector<uint32_t> row_offsets;  // numUsers() + 1
+    std::vector<int> row_movies;        // Índices densos dos filmes (vazio se comprimida)
+    std::vector<uint8_t> row_movie_bytes;          // Deltas em StreamVByte (vazio se não comprimida)
+    std::vector<uint32_t> row_movie_byte_offsets;  // numUsers() + 1 (vazio se não comprimida)
+    std::vector<float> row_ratings;     // Vazio se quantizada
+    std::vector<uint8_t> row_rating_units; // Notas em meias estrelas (vazio se não quantizada)
+    std::vector<GenreMask> movie_genres; // Índice denso do filme -> gêneros (vazio sem catálogo associado)
+    // Termos por usuário das métricas centradas (vazios se a métrica configurada não os usa)
+    std::vector<float> user_means;          // Média das notas do usuário
+    std::vector<float> user_centered_norms; // Norma L2 das notas menos a média
+
+    int numUsers() const { return users.size(); }
+    int numMovies() const { return movies.size(); }
+    uint32_t rowBegin(int user_idx) const { return row_offsets[user_idx]; }
+    uint32_t rowEnd(int user_idx) const { return row_offsets[user_idx + 1]; }
+    uint32_t rowLength(int user_idx) const { return row_offsets[user_idx + 1] - row_offsets[user_idx]; }
+    size_t numRatings() const { return row_offsets.empty() ? 0 : row_offsets.back(); }
+    bool isCompressed() const { return !row_movie_byte_offsets.empty(); }
+
+    bool isQuantized() const { return !row_rating_units.empty(); }
+    // Nota da posição p do CSR em qualquer representação (fora dos laços críticos).
+    float ratingAt(uint32_t p) const { return isQuantized() ? row_rating_units[p] * RATING_UNIT : row_ratings[p]; }
+};
+
+// Normas dos usuários: índice denso do usuário -> norma L2 do vetor de avaliações
+using UserNormsVec = std::vector<float>;
+
+// Alias de tipo para uma lista de vizinhos: Vetor de pares (índice denso do usuário, SimilarityScore)
 using NeighborList = std::vector<std::pair<int, float>>;
 
-// Alias de tipo para uma lista de recomendações: Vetor de pares (MovieID, PredictedScore)
+// Alias de tipo para uma lista de recomendações: Vetor de pares (filme, PredictedScore).
+// Dentro dos motores o filme é o índice denso; na saída é convertido para o MovieID.
 using RecommendationList = std::vector<std::pair<int, float>>;
 
+// Estatísticas das similaridades dos vizinhos (usuários ou itens) que sustentam uma recomendação
+struct NeighborSimilarityStats {
+    uint32_t count = 0;
+    float mean = 0.0f;
+    float min = 0.0f;
+    float max = 0.0f;
+    bool degraded = false; // Resultado parcial: o orçamento da consulta acabou antes do fim
+};
+
+// Orçamento de uma consulta "anytime": prazo (relógio monotônico) e/ou limite de candidatos com
+// cosseno exato. Quando o orçamento acaba a consulta devolve o melhor encontrado até ali e
+// marca `degraded`.
+struct QueryBudget {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    size_t max_candidate_evaluations = 0; // 0 = sem limite
+    bool degraded = false;
+
+    // timeout 0 = sem prazo
+    static QueryBudget start(std::chrono::microseconds timeout, size_t max_candidate_evaluations) {
+        QueryBudget budget;
+        if (timeout.count() > 0) budget.deadline = Clock::now() + timeout;
+        budget.max_candidate_evaluations = max_candidate_evaluations;
+        return budget;
+    }
+
+    bool hasDeadline() const { return deadline != Clock::time_point::max(); }
+    bool isLimited() const { return hasDeadline() || max_candidate_evaluations > 0; }
+    bool expired() const { return hasDeadline() && Clock::now() >= deadline; }
+};
+
 // LSH Related Types
 using Hyperplane = std::vector<float>; // Um único hiperplano
 using HyperplaneSet = std::vector<Hyperplane>; // Um conjunto de hiperplanos para uma tabela hash LSH
 using LSHHashValue = uint64_t; // Tipo do valor hash LSH (se k <= 64)
 
-// Estrutura para uma tabela hash LSH: HashValue -> Lista de UserIDs
-using LSHBucketMap = std::unordered_map<LSHHashValue, std::vector<int>>;
+// Tabela hash LSH com 2^k buckets em formato CSR: os usuários (índices densos, em ordem crescente)
+// do bucket h ocupam [bucket_offsets[h], bucket_offsets[h + 1]) de `bucket_users`.
+// Comprimida (ver compressed_rows.hpp), a lista do bucket h começa em bucket_byte_offsets[h] de
+// `bucket_user_bytes` e `bucket_users` fica vazio; bucket_offsets continua dando os tamanhos.
+struct LSHTable {
+    std::vector<uint32_t> bucket_offsets;  // 2^k + 1
+    std::vector<int> bucket_users;
+    std::vector<uint32_t> bucket_byte_offsets; // 2^k + 1 (apenas comprimida)
+    std::vector<uint8_t> bucket_user_bytes;    // Controle + deltas StreamVByte (apenas comprimida)
+    std::vector<uint32_t> user_buckets;    // Bucket de cada usuário: o hash dos usuários do modelo nunca é recalculado
+
+    bool isCompressed() const { return !bucket_user_bytes.empty(); }
+    uint32_t bucketBegin(LSHHashValue hash) const { return bucket_offsets[hash]; }
+    uint32_t bucketEnd(LSHHashValue hash) const { return bucket_offsets[hash + 1]; }
+};
 
-// Mapeamento de MovieID original para um índice denso (0 a D-1)
-using MovieIdToDenseIdxMap = std::unordered_map<int, int>;
-// Mapeamento reverso (opcional, mas pode ser útil)
+// Mapeamento reverso índice denso -> MovieID guardado nos modelos salvos
 using DenseIdxToMovieIdVec = std::vector<int>;
 
+// Alocador com alinhamento fixo (ex.: 64 bytes = uma linha de cache / um registrador AVX-512),
+// usado em arrays contíguos acessados por laços vetorizados.
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        // aligned_alloc exige que o tamanho seja múltiplo do alinhamento.
+        std::size_t bytes = ((n * sizeof(T) + Alignment - 1) / Alignment) * Alignment;
+        void* ptr = std::aligned_alloc(Alignment, bytes);
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t) noexcept { std::free(ptr); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+constexpr std::size_t SIMD_ALIGNMENT = 64;
+using AlignedFloatVector = std::vector<float, AlignedAllocator<float, SIMD_ALIGNMENT>>;
+
+// Assinaturas SimHash de todos os usuários, contíguas: o usuário u ocupa as palavras
+// [u * num_words, (u + 1) * num_words) de `words`, com 64 bits por palavra.
+struct SimHashSignatures {
+    int num_words = 0;
+    std::vector<uint64_t, AlignedAllocator<uint64_t, SIMD_ALIGNMENT>> words;
+
+    int numBits() const { return 64 * num_words; }
+    bool empty() const { return num_words == 0; }
+    const uint64_t* of(int user_idx) const { return words.data() + static_cast<size_t>(user_idx) * num_words; }
+};
 
 #endif // TYPES_HPP
\ No newline at end of file
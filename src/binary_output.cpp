@@ -0,0 +1,133 @@
+#include "../include/binary_output.hpp"
+#include "../include/recommender_engine.hpp" // Para appendUserRecommendations
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BinaryRecommendationsHeader makeBinaryRecommendationsHeader(uint64_t record_count, int top_n,
+                                                            uint32_t engine, int k_neighbors,
+                                                            int num_lsh_tables, int num_hyperplanes) {
+    BinaryRecommendationsHeader header;
+    std::memcpy(header.magic, BINARY_RECOMMENDATIONS_MAGIC, sizeof(header.magic));
+    header.version = BINARY_RECOMMENDATIONS_VERSION;
+    header.header_size = sizeof(BinaryRecommendationsHeader);
+    header.record_size = static_cast<uint32_t>(binaryRecommendationRecordSize(top_n));
+    header.top_n = static_cast<uint32_t>(top_n);
+    header.record_count = record_count;
+    header.engine = engine;
+    header.k_neighbors = static_cast<uint32_t>(k_neighbors);
+    header.num_lsh_tables = static_cast<uint32_t>(num_lsh_tables);
+    header.num_hyperplanes = static_cast<uint32_t>(num_hyperplanes);
+    return header;
+}
+
+void appendBinaryRecommendationsHeader(std::string& output, const BinaryRecommendationsHeader& header) {
+    output.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void appendUserRecommendationsBinary(std::string& output,
+                                     int target_user_id,
+                                     const NeighborSimilarityStats& neighbor_stats,
+                                     const RecommendationList& recommendations,
+                                     int top_n) {
+    const size_t num_items = std::min(recommendations.size(), static_cast<size_t>(std::max(top_n, 0)));
+
+    BinaryRecommendationRecordPrefix prefix;
+    prefix.user_id = target_user_id;
+    prefix.num_items = static_cast<uint32_t>(num_items);
+    prefix.num_neighbors = neighbor_stats.count;
+    prefix.mean_similarity = neighbor_stats.mean;
+    prefix.min_similarity = neighbor_stats.min;
+    prefix.max_similarity = neighbor_stats.max;
+    prefix.flags = neighbor_stats.degraded ? BINARY_RECORD_FLAG_DEGRADED : 0;
+
+    // Escreve direto no buffer (sem arrays temporários): prefixo, IDs e notas.
+    size_t offset = output.size();
+    output.resize(offset + binaryRecommendationRecordSize(top_n));
+    char* base = &output[offset];
+    std::memcpy(base, &prefix, sizeof(prefix));
+
+    char* ids = base + sizeof(prefix);
+    char* scores = ids + static_cast<size_t>(top_n) * sizeof(int32_t);
+    for (int i = 0; i < top_n; ++i) {
+        int32_t movie_id = -1;
+        float score = 0.0f;
+        if (static_cast<size_t>(i) < num_items) {
+            movie_id = recommendations[i].first;
+            score = recommendations[i].second;
+        }
+        std::memcpy(ids + i * sizeof(int32_t), &movie_id, sizeof(movie_id));
+        std::memcpy(scores + i * sizeof(float), &score, sizeof(score));
+    }
+}
+
+MappedBinaryRecommendations::~MappedBinaryRecommendations() {
+    close();
+}
+
+bool MappedBinaryRecommendations::open(const std::string& input_path) {
+    close();
+    int fd = ::open(input_path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Erro: Não foi possível abrir o arquivo binário de recomendações: " << input_path << std::endl;
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || static_cast<size_t>(sb.st_size) < sizeof(BinaryRecommendationsHeader)) {
+        std::cerr << "Erro: Arquivo binário de recomendações inválido: " << input_path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    size_t file_size = sb.st_size;
+    void* mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Erro: Falha no mmap()." << std::endl;
+        return false;
+    }
+    data_ = static_cast<const char*>(mapped);
+    size_ = file_size;
+
+    const BinaryRecommendationsHeader& h = header();
+    bool valid = std::memcmp(h.magic, BINARY_RECOMMENDATIONS_MAGIC, sizeof(h.magic)) == 0 &&
+                 h.version == BINARY_RECOMMENDATIONS_VERSION &&
+                 h.header_size >= sizeof(BinaryRecommendationsHeader) &&
+                 h.record_size == binaryRecommendationRecordSize(static_cast<int>(h.top_n)) &&
+                 h.header_size + h.record_count * h.record_size <= size_;
+    if (!valid) {
+        std::cerr << "Erro: Cabeçalho do arquivo binário de recomendações inválido: " << input_path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedBinaryRecommendations::close() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+void appendBinaryRecordAsText(std::string& output,
+                              const MappedBinaryRecommendations& mapped,
+                              size_t record_index,
+                              const MovieCatalog& movie_catalog) {
+    const BinaryRecommendationRecordPrefix& prefix = mapped.record(record_index);
+    const int32_t* ids = mapped.itemIds(record_index);
+    const float* scores = mapped.scores(record_index);
+
+    RecommendationList recommendations;
+    recommendations.reserve(prefix.num_items);
+    for (uint32_t i = 0; i < prefix.num_items; ++i) {
+        recommendations.emplace_back(ids[i], scores[i]);
+    }
+    appendUserRecommendations(output, prefix.user_id, prefix.mean_similarity,
+                              recommendations, movie_catalog, mapped.topN(),
+                              (prefix.flags & BINARY_RECORD_FLAG_DEGRADED) != 0);
+}
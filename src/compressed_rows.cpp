@@ -0,0 +1,143 @@
+#include "../include/compressed_rows.hpp"
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+StreamVByteTables buildStreamVByteTables() {
+    StreamVByteTables tables;
+    for (int control = 0; control < 256; ++control) {
+        int source = 0;
+        for (int i = 0; i < 4; ++i) {
+            int length = ((control >> (2 * i)) & 3) + 1;
+            for (int b = 0; b < 4; ++b) {
+                // 0x80 zera o byte de destino no _mm_shuffle_epi8.
+                tables.shuffle[control][4 * i + b] = b < length ? static_cast<uint8_t>(source + b) : 0x80;
+            }
+            source += length;
+        }
+        tables.length[control] = static_cast<uint8_t>(source);
+    }
+    return tables;
+}
+
+// Código de 2 bits do StreamVByte: número de bytes do valor menos 1.
+inline uint32_t streamVByteCode(uint32_t value) {
+    if (value < (1u << 8)) return 0;
+    if (value < (1u << 16)) return 1;
+    if (value < (1u << 24)) return 2;
+    return 3;
+}
+
+// Bytes de uma lista crescente comprimida: controle + deltas.
+uint32_t streamVByteEncodedSize(const int* values, uint32_t n) {
+    uint32_t bytes = (n + 3) / 4;
+    int prev = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        bytes += streamVByteCode(static_cast<uint32_t>(values[i] - prev)) + 1;
+        prev = values[i];
+    }
+    return bytes;
+}
+
+// Codifica a lista em `out` (os bytes de controle precisam estar zerados).
+void encodeStreamVByte(const int* values, uint32_t n, uint8_t* out) {
+    uint8_t* control = out;
+    uint8_t* data = control + (n + 3) / 4;
+    int prev = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t delta = static_cast<uint32_t>(values[i] - prev);
+        prev = values[i];
+        uint32_t code = streamVByteCode(delta);
+        control[i / 4] |= static_cast<uint8_t>(code << (2 * (i % 4)));
+        std::memcpy(data, &delta, code + 1); // Little-endian
+        data += code + 1;
+    }
+}
+
+// Decodifica a lista inteira em `scratch` (arredondado para múltiplo de 4: cada grupo grava 4 inteiros).
+const int* decodeStreamVByte(const uint8_t* encoded, uint32_t n, std::vector<int>& scratch) {
+    const uint32_t groups = (n + 3) / 4;
+    if (scratch.size() < 4 * groups) scratch.resize(4 * groups);
+    const uint8_t* data = encoded + groups;
+    int* out = scratch.data();
+    int prev = 0;
+    for (uint32_t g = 0; g < groups; ++g, out += 4) {
+        data = decodeStreamVByteGroup(encoded[g], data, prev, out);
+        prev = out[3];
+    }
+    return scratch.data();
+}
+
+} // namespace
+
+const StreamVByteTables STREAMVBYTE_TABLES = buildStreamVByteTables();
+
+const int* rowMovieIndices(const RatingMatrix& matrix, int user_idx, std::vector<int>& scratch) {
+    if (!matrix.isCompressed()) return matrix.row_movies.data() + matrix.rowBegin(user_idx);
+    return decodeStreamVByte(matrix.row_movie_bytes.data() + matrix.row_movie_byte_offsets[user_idx],
+                             matrix.rowLength(user_idx), scratch);
+}
+
+void compressRatingRows(RatingMatrix& matrix) {
+    const int U = matrix.numUsers();
+    if (matrix.isCompressed() || U == 0) return;
+
+    // 1. Tamanho comprimido de cada linha (bytes de controle + bytes dos deltas).
+    std::vector<uint32_t> row_bytes(U);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < U; ++u) {
+        row_bytes[u] = streamVByteEncodedSize(matrix.row_movies.data() + matrix.rowBegin(u), matrix.rowLength(u));
+    }
+
+    matrix.row_movie_byte_offsets.assign(U + 1, 0);
+    for (int u = 0; u < U; ++u) {
+        matrix.row_movie_byte_offsets[u + 1] = matrix.row_movie_byte_offsets[u] + row_bytes[u];
+    }
+    matrix.row_movie_bytes.assign(matrix.row_movie_byte_offsets[U] + STREAMVBYTE_PADDING, 0);
+
+    // 2. Codifica as linhas em paralelo, cada uma na sua faixa do buffer.
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < U; ++u) {
+        encodeStreamVByte(matrix.row_movies.data() + matrix.rowBegin(u), matrix.rowLength(u),
+                          matrix.row_movie_bytes.data() + matrix.row_movie_byte_offsets[u]);
+    }
+
+    matrix.row_movies.clear();
+    matrix.row_movies.shrink_to_fit();
+}
+
+const int* bucketUserIndices(const LSHTable& table, LSHHashValue hash, std::vector<int>& scratch) {
+    if (!table.isCompressed()) return table.bucket_users.data() + table.bucketBegin(hash);
+    return decodeStreamVByte(table.bucket_user_bytes.data() + table.bucket_byte_offsets[hash],
+                             table.bucketEnd(hash) - table.bucketBegin(hash), scratch);
+}
+
+void compressLSHBuckets(std::vector<LSHTable>& lsh_tables) {
+    for (LSHTable& table : lsh_tables) {
+        if (table.isCompressed() || table.bucket_offsets.empty()) continue;
+        const size_t num_buckets = table.bucket_offsets.size() - 1;
+
+        // Mesmo esquema de compressRatingRows: tamanhos, offsets e codificação paralela por bucket.
+        table.bucket_byte_offsets.assign(num_buckets + 1, 0);
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (size_t h = 0; h < num_buckets; ++h) {
+            table.bucket_byte_offsets[h + 1] = streamVByteEncodedSize(
+                table.bucket_users.data() + table.bucketBegin(h), table.bucketEnd(h) - table.bucketBegin(h));
+        }
+        for (size_t h = 0; h < num_buckets; ++h) table.bucket_byte_offsets[h + 1] += table.bucket_byte_offsets[h];
+        table.bucket_user_bytes.assign(table.bucket_byte_offsets[num_buckets] + STREAMVBYTE_PADDING, 0);
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (size_t h = 0; h < num_buckets; ++h) {
+            encodeStreamVByte(table.bucket_users.data() + table.bucketBegin(h), table.bucketEnd(h) - table.bucketBegin(h),
+                              table.bucket_user_bytes.data() + table.bucket_byte_offsets[h]);
+        }
+
+        table.bucket_users.clear();
+        table.bucket_users.shrink_to_fit();
+    }
+}
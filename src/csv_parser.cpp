@@ -1,6 +1,9 @@
 #include "../include/csv_parser.hpp"
 #include "../include/config.hpp"
+#include "../include/output_writer.hpp"
+#include "../include/memory_placement.hpp"
 #include <fstream>      
+#include <cstdio>
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -9,6 +12,8 @@
 #include <charconv>
 #include <unordered_set>
 #include <unordered_map>
+#include <memory>
+#include <memory_resource>
 #include <thread>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -33,6 +38,12 @@ bool parseInt(std::string_view sv, int& out_val) {
     return ec == std::errc(); // Retorna true se não houver erro.
 }
 
+// Sobrecarga para timestamps (segundos Unix não cabem em int depois de 2038).
+bool parseInt(std::string_view sv, int64_t& out_val) {
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), out_val);
+    return ec == std::errc();
+}
+
 /**
  * @brief Converte eficientemente uma substring (string_view) para um float.
  * @return true se a conversão for bem-sucedida, false caso contrário.
@@ -44,105 +55,194 @@ bool parseFloat(std::string_view sv, float& out_val) {
 
 // --- Implementações das Funções de Pré-processamento ---
 
-MovieTitlesMap readMovieTitles(const std::string& movies_csv_path) {
-    MovieTitlesMap movie_titles;
-    std::ifstream file(movies_csv_path, std::ios::binary);
-    if (!file) {
-        std::cerr << "Erro: Não foi possível abrir o arquivo de filmes: " << movies_csv_path << std::endl;
-        return movie_titles;
-    }
-
-    // Pré-aloca memória para o mapa para evitar realocações custosas durante a inserção.
-    movie_titles.reserve(NUM_EXPECTED_UNIQUE_MOVIES);
-
-    std::string line;
-    std::getline(file, line); // Pula a linha do cabeçalho (header).
-
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        // Remove o caractere de retorno de carro '\r' se o arquivo for do formato Windows.
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-
-        std::string_view sv(line);
-        auto first_comma = sv.find(',');
-        if (first_comma == std::string_view::npos) continue;
-
-        int movie_id;
-        if (!parseInt(sv.substr(0, first_comma), movie_id)) continue;
-        
-        // Remove o ID e a primeira vírgula para isolar o título e os gêneros.
-        sv.remove_prefix(first_comma + 1);
-
-        // Lida com títulos que contêm vírgulas e, por isso, estão entre aspas.
-        std::string title_str;
-        if (!sv.empty() && sv.front() == '"') {
-            sv.remove_prefix(1); // Remove a aspa inicial.
-            auto last_quote = sv.find_last_of('"');
-            if (last_quote != std::string_view::npos) {
-                title_str = std::string(sv.substr(0, last_quote));
-            } else {
-                 title_str = std::string(sv); // Caso de aspa não fechada.
-            }
-        } else {
-            // Se não há aspas, o título vai até a última vírgula (que separa dos gêneros).
-            auto last_comma = sv.find_last_of(',');
-            if(last_comma != std::string_view::npos) {
-                title_str = std::string(sv.substr(0, last_comma));
-            } else {
-                title_str = std::string(sv);
+GenreMask parseGenreMask(std::string_view genres) {
+    GenreMask mask = 0;
+    while (!genres.empty()) {
+        auto separator = genres.find('|');
+        std::string_view genre = genres.substr(0, separator);
+        for (int g = 0; g < NUM_MOVIE_GENRES; ++g) {
+            if (MOVIE_GENRE_NAMES[g] == genre) {
+                mask |= (GenreMask(1) << g);
+                break;
             }
         }
-        movie_titles[movie_id] = std::move(title_str);
+        if (separator == std::string_view::npos) break;
+        genres.remove_prefix(separator + 1);
     }
-    return movie_titles;
+    return mask;
 }
 
-void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_ratings_log) {
-    // --- OTIMIZAÇÃO DE I/O: Memory-Mapped File (mmap) ---
-    // 1. Abrimos o arquivo usando um descritor de arquivo de baixo nível (C-style).
-    int fd = open(ratings_csv_path.c_str(), O_RDONLY);
+MovieCatalog readMovieCatalog(const std::string& movies_csv_path) {
+    MovieCatalog catalog;
+
+    // Mesma estratégia de readRatingsCSV: mmap do arquivo inteiro e blocos por thread.
+    int fd = open(movies_csv_path.c_str(), O_RDONLY);
     if (fd == -1) {
-        std::cerr << "Erro: Não foi possível abrir o arquivo de avaliações com open(): " << ratings_csv_path << std::endl;
-        return;
+        std::cerr << "Erro: Não foi possível abrir o arquivo de filmes: " << movies_csv_path << std::endl;
+        return catalog;
     }
-
-    // 2. Obtemos o tamanho do arquivo para saber a quantidade de memória a mapear.
     struct stat sb;
-    if (fstat(fd, &sb) == -1) {
-        std::cerr << "Erro: Não foi possível obter o tamanho do arquivo com fstat()." << std::endl;
+    if (fstat(fd, &sb) == -1 || sb.st_size == 0) {
         close(fd);
-        return;
+        return catalog;
     }
     size_t file_size = sb.st_size;
-
-    // 3. Mapeamos o arquivo na memória virtual do processo.
-    // Isso evita cópias de dados entre o kernel e o espaço do usuário, sendo a forma mais rápida de ler um arquivo.
-    // O sistema operacional gerencia o carregamento das páginas do arquivo sob demanda.
     char* file_content = static_cast<char*>(mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
     if (file_content == MAP_FAILED) {
         std::cerr << "Erro: Falha no mmap()." << std::endl;
-        close(fd);
-        return;
+        return catalog;
     }
-    close(fd); // O descritor de arquivo pode ser fechado após o mmap.
+    if (ADVISE_MAPPED_INPUTS) adviseMappedInput(file_content, file_size);
 
-    // Pula o cabeçalho (header) encontrando a primeira quebra de linha.
-    // Usamos memchr por ser mais rápido que std::string::find para buffers de char.
+    // Pula o cabeçalho (header).
     char* header_end = static_cast<char*>(memchr(file_content, '\n', file_size));
     if (!header_end) {
         munmap(file_content, file_size);
-        return; 
+        return catalog;
     }
     char* content_start = header_end + 1;
     size_t content_size = file_size - (content_start - file_content);
 
-    users_ratings_log.clear();
+    // Resultado parcial de cada thread; os offsets são relativos à arena local.
+    struct LocalCatalog {
+        std::string arena;
+        std::vector<MovieTitleRecord> titles;
+        std::vector<GenreMask> genre_masks;
+        std::vector<int> movie_ids;
+    };
+    int num_threads = 1;
+    #ifdef _OPENMP
+        #pragma omp parallel
+        {
+            #pragma omp single
+            num_threads = omp_get_num_threads();
+        }
+    #endif
+    std::vector<LocalCatalog> local_catalogs(num_threads);
 
+    #pragma omp parallel
+    {
+        int thread_id = 0;
+        #ifdef _OPENMP
+            thread_id = omp_get_thread_num();
+        #endif
+        size_t chunk_size = content_size / num_threads;
+        size_t start_offset = thread_id * chunk_size;
+        size_t end_offset = (thread_id == num_threads - 1) ? content_size : (thread_id + 1) * chunk_size;
+
+        // Ajusta os limites do bloco para linhas inteiras (igual a readRatingsCSV).
+        if (thread_id > 0 && start_offset > 0 && content_start[start_offset - 1] != '\n') {
+            char* EOL = static_cast<char*>(memchr(content_start + start_offset, '\n', content_size - start_offset));
+            start_offset = EOL ? static_cast<size_t>(EOL - content_start + 1) : content_size;
+        }
+        if (thread_id < num_threads - 1 && end_offset < content_size && content_start[end_offset - 1] != '\n') {
+            char* EOL = static_cast<char*>(memchr(content_start + end_offset, '\n', content_size - end_offset));
+            end_offset = EOL ? static_cast<size_t>(EOL - content_start + 1) : content_size;
+        }
+
+        LocalCatalog& local = local_catalogs[thread_id];
+        if (start_offset < end_offset) {
+            local.arena.reserve((end_offset - start_offset) * 3 / 4);
+            char* current_pos = content_start + start_offset;
+            char* end_pos = content_start + end_offset;
+
+            while (current_pos < end_pos) {
+                char* next_newline = static_cast<char*>(memchr(current_pos, '\n', end_pos - current_pos));
+                char* line_end = next_newline ? next_newline : end_pos;
+                std::string_view sv(current_pos, line_end - current_pos);
+                if (!sv.empty() && sv.back() == '\r') sv.remove_suffix(1);
+
+                auto first_comma = sv.find(',');
+                int movie_id;
+                if (first_comma != std::string_view::npos && parseInt(sv.substr(0, first_comma), movie_id)) {
+                    // Remove o ID e a primeira vírgula para isolar o título e os gêneros.
+                    sv.remove_prefix(first_comma + 1);
+
+                    // Títulos que contêm vírgulas estão entre aspas.
+                    std::string_view title = sv;
+                    std::string_view genres;
+                    if (!sv.empty() && sv.front() == '"') {
+                        sv.remove_prefix(1); // Remove a aspa inicial.
+                        auto last_quote = sv.find_last_of('"');
+                        if (last_quote != std::string_view::npos) {
+                            title = sv.substr(0, last_quote);
+                            auto genres_comma = sv.find(',', last_quote);
+                            if (genres_comma != std::string_view::npos) genres = sv.substr(genres_comma + 1);
+                        } else {
+                            title = sv; // Caso de aspa não fechada.
+                        }
+                    } else {
+                        // Se não há aspas, o título vai até a última vírgula (que separa dos gêneros).
+                        auto last_comma = sv.find_last_of(',');
+                        if (last_comma != std::string_view::npos) {
+                            title = sv.substr(0, last_comma);
+                            genres = sv.substr(last_comma + 1);
+                        }
+                    }
+
+                    local.titles.push_back({static_cast<uint32_t>(local.arena.size()), static_cast<uint32_t>(title.size())});
+                    local.arena.append(title.data(), title.size());
+                    local.genre_masks.push_back(parseGenreMask(genres));
+                    local.movie_ids.push_back(movie_id);
+                }
+                if (!next_newline) break;
+                current_pos = next_newline + 1;
+            }
+        }
+    }
+    munmap(file_content, file_size);
+
+    // Fase de Redução: concatena as arenas locais na ordem das threads (= ordem do arquivo).
+    size_t total_movies = 0, total_chars = 0;
+    int max_movie_id = -1;
+    for (const auto& local : local_catalogs) {
+        total_movies += local.movie_ids.size();
+        total_chars += local.arena.size();
+        for (int movie_id : local.movie_ids) max_movie_id = std::max(max_movie_id, movie_id);
+    }
+    catalog.title_arena.reserve(total_chars);
+    catalog.titles.reserve(total_movies);
+    catalog.genre_masks.reserve(total_movies);
+    catalog.movie_ids.reserve(total_movies);
+    catalog.index_of_movie.assign(max_movie_id + 1, -1);
+
+    for (const auto& local : local_catalogs) {
+        uint32_t base_offset = static_cast<uint32_t>(catalog.title_arena.size());
+        catalog.title_arena += local.arena;
+        for (size_t i = 0; i < local.movie_ids.size(); ++i) {
+            int movie_id = local.movie_ids[i];
+            if (movie_id < 0) continue;
+            int catalog_idx = static_cast<int>(catalog.movie_ids.size());
+            // IDs repetidos: prevalece a última ocorrência, como no mapa anterior.
+            catalog.index_of_movie[movie_id] = catalog_idx;
+            catalog.movie_ids.push_back(movie_id);
+            catalog.titles.push_back({base_offset + local.titles[i].offset, local.titles[i].length});
+            catalog.genre_masks.push_back(local.genre_masks[i]);
+        }
+    }
+    return catalog;
+}
+
+namespace {
+
+struct RatingsParseResult {
+    size_t num_ratings = 0;
+    int64_t max_timestamp = -1; // Maior timestamp entre as linhas aplicadas (só com track_timestamps)
+};
+
+/**
+ * @brief Parsing paralelo de um trecho do CSV de avaliações (sem cabeçalho), acrescentando as
+ * linhas ao log (as avaliações de cada usuário ficam na ordem do arquivo).
+ * @param track_timestamps Se true, lê a coluna timestamp: linhas com timestamp <= min_timestamp
+ * são ignoradas e o maior timestamp aplicado é devolvido.
+ */
+RatingsParseResult parseRatingsLines(const char* content_start, size_t content_size, UserRatingsLog& users_ratings_log,
+                                     bool track_timestamps, int64_t min_timestamp) {
     // --- Lógica de Processamento Paralelo ---
     // Cria um log de avaliações local para cada thread para evitar "race conditions".
-    std::vector<UserRatingsLog> thread_local_logs;
+    // Cada log local vive em uma arena própria (sem locks): os milhões de vetores que crescem por
+    // emplace_back ocupam blocos grandes, descartados de uma vez ao fim da função.
     int num_threads = 1;
     #ifdef _OPENMP
         #pragma omp parallel
@@ -151,13 +251,20 @@ void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_r
             num_threads = omp_get_num_threads();
         }
     #endif
-    thread_local_logs.resize(num_threads);
-    for(auto& log : thread_local_logs) {
-        log.reserve(NUM_EXPECTED_UNIQUE_USERS / num_threads);
+    std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> thread_arenas;
+    std::vector<UserRatingsLog> thread_local_logs;
+    thread_arenas.reserve(num_threads);
+    thread_local_logs.reserve(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+        thread_arenas.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>(
+            std::max<size_t>(content_size / num_threads, 64 * 1024)));
+        thread_local_logs.emplace_back(thread_arenas.back().get());
+        thread_local_logs.back().reserve(NUM_EXPECTED_UNIQUE_USERS / num_threads);
     }
     
     // Inicia a região paralela. Cada thread processará um "chunk" (pedaço) do arquivo.
-    #pragma omp parallel
+    int64_t max_timestamp = -1;
+    #pragma omp parallel reduction(max:max_timestamp)
     {
         int thread_id = omp_get_thread_num();
         size_t chunk_size = content_size / num_threads;
@@ -167,13 +274,13 @@ void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_r
         // Ajusta os offsets de início e fim para garantir que não cortemos linhas ao meio.
         // A thread 0 começa no início. As outras threads buscam a próxima quebra de linha a partir do seu 'start_offset'.
         if (thread_id > 0 && start_offset > 0 && content_start[start_offset - 1] != '\n') {
-            char* EOL = static_cast<char*>(memchr(content_start + start_offset, '\n', content_size - start_offset));
+            const char* EOL = static_cast<const char*>(memchr(content_start + start_offset, '\n', content_size - start_offset));
             if (EOL) {
                 start_offset = EOL - content_start + 1;
             }
         }
         if (thread_id < num_threads - 1 && end_offset < content_size) {
-             char* EOL = static_cast<char*>(memchr(content_start + end_offset, '\n', content_size - end_offset));
+             const char* EOL = static_cast<const char*>(memchr(content_start + end_offset, '\n', content_size - end_offset));
             if (EOL) {
                 end_offset = EOL - content_start + 1;
             }
@@ -181,13 +288,13 @@ void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_r
         
         if (start_offset < end_offset) {
             UserRatingsLog& local_log = thread_local_logs[thread_id];
-            char* current_pos = content_start + start_offset;
-            char* end_pos = content_start + end_offset;
+            const char* current_pos = content_start + start_offset;
+            const char* end_pos = content_start + end_offset;
 
             // Itera sobre as linhas dentro do chunk da thread
             while(current_pos < end_pos) {
-                char* next_newline = static_cast<char*>(memchr(current_pos, '\n', end_pos - current_pos));
-                char* line_end = next_newline ? next_newline : end_pos;
+                const char* next_newline = static_cast<const char*>(memchr(current_pos, '\n', end_pos - current_pos));
+                const char* line_end = next_newline ? next_newline : end_pos;
                 
                 std::string_view line(current_pos, line_end - current_pos);
 
@@ -203,7 +310,19 @@ void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_r
                             if (parseInt(line.substr(0, first_comma), user_id) &&
                                 parseInt(line.substr(first_comma + 1, second_comma - first_comma - 1), movie_id) &&
                                 parseFloat(line.substr(second_comma + 1), rating)) {
-                                local_log[user_id].emplace_back(movie_id, rating);
+                                bool apply = true;
+                                if (track_timestamps) {
+                                    // Linhas sem timestamp valem 0: nunca passam de um watermark.
+                                    int64_t timestamp = 0;
+                                    auto third_comma = line.find(',', second_comma + 1);
+                                    if (third_comma == std::string_view::npos ||
+                                        !parseInt(line.substr(third_comma + 1), timestamp)) {
+                                        timestamp = 0;
+                                    }
+                                    apply = timestamp > min_timestamp;
+                                    if (apply) max_timestamp = std::max(max_timestamp, timestamp);
+                                }
+                                if (apply) local_log[user_id].emplace_back(movie_id, rating);
                             }
                         }
                     }
@@ -214,20 +333,307 @@ void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_r
         }
     }
 
-    // Fase de Redução (Merge): Combina os resultados dos logs locais no log final.
-    // Esta fase é sequencial, mas rápida, pois apenas move ponteiros.
+    // Fase de Redução (Merge): Combina os resultados dos logs locais no log final, no recurso de
+    // memória do chamador. Cada linha é copiada uma vez, já com o tamanho final.
+    RatingsParseResult result;
+    result.max_timestamp = max_timestamp;
     users_ratings_log.reserve(NUM_EXPECTED_UNIQUE_USERS);
     for (const auto& local_log : thread_local_logs) {
         for (const auto& [user_id, ratings] : local_log) {
-            users_ratings_log[user_id].insert(users_ratings_log[user_id].end(), ratings.begin(), ratings.end());
+            UserRatings& merged = users_ratings_log[user_id];
+            merged.insert(merged.end(), ratings.begin(), ratings.end());
+            result.num_ratings += ratings.size();
         }
     }
+    thread_local_logs.clear();
+    thread_arenas.clear();
+    return result;
+}
     
+
+} // namespace
+
+void readRatingsCSV(const std::string& ratings_csv_path, UserRatingsLog& users_ratings_log) {
+    // --- OTIMIZAÇÃO DE I/O: Memory-Mapped File (mmap) ---
+    // 1. Abrimos o arquivo usando um descritor de arquivo de baixo nível (C-style).
+    int fd = open(ratings_csv_path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Erro: Não foi possível abrir o arquivo de avaliações com open(): " << ratings_csv_path << std::endl;
+        return;
+    }
+
+    // 2. Obtemos o tamanho do arquivo para saber a quantidade de memória a mapear.
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+        std::cerr << "Erro: Não foi possível obter o tamanho do arquivo com fstat()." << std::endl;
+        close(fd);
+        return;
+    }
+    size_t file_size = sb.st_size;
+
+    // 3. Mapeamos o arquivo na memória virtual do processo.
+    // Isso evita cópias de dados entre o kernel e o espaço do usuário, sendo a forma mais rápida de ler um arquivo.
+    // O sistema operacional gerencia o carregamento das páginas do arquivo sob demanda.
+    char* file_content = static_cast<char*>(mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    if (file_content == MAP_FAILED) {
+        std::cerr << "Erro: Falha no mmap()." << std::endl;
+        close(fd);
+        return;
+    }
+    close(fd); // O descritor de arquivo pode ser fechado após o mmap.
+    // Opcional: pede ao kernel a leitura antecipada do arquivo inteiro (as threads leem blocos distantes).
+    if (ADVISE_MAPPED_INPUTS) adviseMappedInput(file_content, file_size);
+
+    // Pula o cabeçalho (header) encontrando a primeira quebra de linha.
+    // Usamos memchr por ser mais rápido que std::string::find para buffers de char.
+    char* header_end = static_cast<char*>(memchr(file_content, '\n', file_size));
+    if (!header_end) {
+        munmap(file_content, file_size);
+        return; 
+    }
+    char* content_start = header_end + 1;
+    size_t content_size = file_size - (content_start - file_content);
+
+    users_ratings_log.clear();
+    parseRatingsLines(content_start, content_size, users_ratings_log, false, 0);
+
     // Libera a memória mapeada.
     munmap(file_content, file_size);
 }
 
 
+namespace {
+
+const char RATINGS_SNAPSHOT_MAGIC[8] = {'R', 'A', 'T', 'S', 'N', 'A', 'P', '1'};
+// Bytes do início do CSV e de antes do ponto consumido usados para detectar um arquivo reescrito.
+constexpr size_t SNAPSHOT_FINGERPRINT_BYTES = 4096;
+
+struct RatingsSnapshotHeader {
+    char magic[8];
+    uint64_t consumed_bytes;     // Fim da última linha completa do CSV já aplicada
+    int64_t max_timestamp;       // Watermark: maior timestamp aplicado
+    uint64_t source_fingerprint; // Hash do início do CSV e dos bytes antes de consumed_bytes
+    uint64_t snapshot_bytes;     // Bytes válidos do snapshot (cabeçalho + segmentos)
+    uint32_t num_segments;
+    uint32_t reserved;
+};
+
+// Avaliação no snapshot; um segmento é {num_users} e, por usuário, {user_id, count, count x SnapshotRating}.
+struct SnapshotRating {
+    int32_t movie_id;
+    float rating;
+};
+
+uint64_t fingerprintConsumedInput(const char* file_content, size_t consumed_bytes) {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    auto mix = [&hash](const char* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+    };
+    const size_t head = std::min(consumed_bytes, SNAPSHOT_FINGERPRINT_BYTES);
+    const size_t tail = std::min(consumed_bytes - head, SNAPSHOT_FINGERPRINT_BYTES);
+    mix(file_content, head);
+    mix(file_content + consumed_bytes - tail, tail);
+    return hash;
+}
+
+// Grava um segmento e devolve o número de bytes escritos.
+uint64_t writeSnapshotSegment(std::ostream& out, const UserRatingsLog& log) {
+    const uint64_t num_users = log.size();
+    out.write(reinterpret_cast<const char*>(&num_users), sizeof(num_users));
+    uint64_t bytes = sizeof(num_users);
+    std::vector<SnapshotRating> row;
+    for (const auto& [user_id, ratings] : log) {
+        const int32_t id = user_id;
+        const uint32_t count = static_cast<uint32_t>(ratings.size());
+        row.clear();
+        for (const auto& [movie_id, rating] : ratings) row.push_back({movie_id, rating});
+        out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(SnapshotRating));
+        bytes += sizeof(id) + sizeof(count) + row.size() * sizeof(SnapshotRating);
+    }
+    return bytes;
+}
+
+// Acrescenta ao log os segmentos em [data, data + size). false se o conteúdo estiver truncado.
+bool loadSnapshotSegments(const char* data, size_t size, uint32_t num_segments, UserRatingsLog& log) {
+    const char* pos = data;
+    const char* end = data + size;
+    auto read = [&pos, end](void* out, size_t bytes) {
+        if (static_cast<size_t>(end - pos) < bytes) return false;
+        memcpy(out, pos, bytes);
+        pos += bytes;
+        return true;
+    };
+    log.reserve(NUM_EXPECTED_UNIQUE_USERS);
+    for (uint32_t segment = 0; segment < num_segments; ++segment) {
+        uint64_t num_users = 0;
+        if (!read(&num_users, sizeof(num_users))) return false;
+        for (uint64_t u = 0; u < num_users; ++u) {
+            int32_t user_id;
+            uint32_t count;
+            if (!read(&user_id, sizeof(user_id)) || !read(&count, sizeof(count)) ||
+                static_cast<size_t>(end - pos) < count * sizeof(SnapshotRating)) {
+                return false;
+            }
+            UserRatings& ratings = log[user_id];
+            ratings.reserve(ratings.size() + count);
+            for (uint32_t i = 0; i < count; ++i) {
+                SnapshotRating entry;
+                memcpy(&entry, pos, sizeof(entry));
+                pos += sizeof(entry);
+                ratings.emplace_back(entry.movie_id, entry.rating);
+            }
+        }
+    }
+    return true;
+}
+
+// Regrava o snapshot inteiro (um segmento) em um arquivo temporário renomeado ao final.
+bool rewriteRatingsSnapshot(const std::string& snapshot_path, RatingsSnapshotHeader header, const UserRatingsLog& log) {
+    const std::string temporary_path = snapshot_path + ".tmp";
+    std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    header.num_segments = 1;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    header.snapshot_bytes = sizeof(header) + writeSnapshotSegment(out, log);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    return out && rename(temporary_path.c_str(), snapshot_path.c_str()) == 0;
+}
+
+// Acrescenta um segmento depois dos bytes válidos e só então atualiza o cabeçalho: uma gravação
+// interrompida deixa o snapshot anterior intacto.
+bool appendRatingsSnapshotSegment(const std::string& snapshot_path, RatingsSnapshotHeader header,
+                                  const UserRatingsLog& new_ratings) {
+    if (truncate(snapshot_path.c_str(), header.snapshot_bytes) != 0) return false;
+    uint64_t segment_bytes = 0;
+    {
+        std::ofstream out(snapshot_path, std::ios::binary | std::ios::app);
+        if (!out) return false;
+        segment_bytes = writeSnapshotSegment(out, new_ratings);
+        out.close();
+        if (!out) return false;
+    }
+    header.snapshot_bytes += segment_bytes;
+    header.num_segments += 1;
+    std::fstream out(snapshot_path, std::ios::binary | std::ios::in | std::ios::out);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+RatingsIngestionStats readRatingsCSVIncremental(const std::string& ratings_csv_path,
+                                                const std::string& snapshot_path,
+                                                UserRatingsLog& users_ratings_log) {
+    RatingsIngestionStats stats;
+    users_ratings_log.clear();
+
+    int fd = open(ratings_csv_path.c_str(), O_RDONLY);
+    struct stat sb;
+    if (fd == -1 || fstat(fd, &sb) == -1) {
+        std::cerr << "Erro: Não foi possível abrir o arquivo de avaliações: " << ratings_csv_path << std::endl;
+        if (fd != -1) close(fd);
+        return stats;
+    }
+    const size_t file_size = sb.st_size;
+    char* file_content = file_size ? static_cast<char*>(mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0)) : nullptr;
+    close(fd);
+    if (file_content == MAP_FAILED || !file_content) {
+        std::cerr << "Erro: Falha no mmap()." << std::endl;
+        return stats;
+    }
+    if (ADVISE_MAPPED_INPUTS) adviseMappedInput(file_content, file_size);
+
+    // Linhas completas: do fim do cabeçalho até a última quebra de linha.
+    const char* header_end = static_cast<const char*>(memchr(file_content, '\n', file_size));
+    const char* last_newline = static_cast<const char*>(memrchr(file_content, '\n', file_size));
+    if (!header_end) {
+        munmap(file_content, file_size);
+        return stats;
+    }
+    const size_t content_offset = header_end + 1 - file_content;
+    const size_t complete_end = last_newline + 1 - file_content;
+
+    // Snapshot anterior: mapeado só para leitura, no máximo uma vez por execução.
+    RatingsSnapshotHeader header{};
+    bool has_snapshot = false;
+    int snapshot_fd = open(snapshot_path.c_str(), O_RDONLY);
+    struct stat snapshot_sb;
+    if (snapshot_fd != -1 && fstat(snapshot_fd, &snapshot_sb) == 0 &&
+        static_cast<size_t>(snapshot_sb.st_size) >= sizeof(header)) {
+        void* snapshot = mmap(NULL, snapshot_sb.st_size, PROT_READ, MAP_PRIVATE, snapshot_fd, 0);
+        if (snapshot != MAP_FAILED) {
+            memcpy(&header, snapshot, sizeof(header));
+            has_snapshot = memcmp(header.magic, RATINGS_SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+                           header.snapshot_bytes <= static_cast<uint64_t>(snapshot_sb.st_size) &&
+                           loadSnapshotSegments(static_cast<const char*>(snapshot) + sizeof(header),
+                                                header.snapshot_bytes - sizeof(header), header.num_segments,
+                                                users_ratings_log);
+            munmap(snapshot, snapshot_sb.st_size);
+        }
+    }
+    if (snapshot_fd != -1) close(snapshot_fd);
+    if (!has_snapshot) users_ratings_log.clear();
+
+    if (!has_snapshot) {
+        stats.mode = RatingsIngestionMode::FULL;
+        RatingsParseResult parsed = parseRatingsLines(file_content + content_offset, complete_end - content_offset,
+                                                      users_ratings_log, true, -1);
+        memcpy(header.magic, RATINGS_SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.consumed_bytes = complete_end;
+        header.max_timestamp = parsed.max_timestamp;
+        header.source_fingerprint = fingerprintConsumedInput(file_content, complete_end);
+        stats.bytes_parsed = complete_end - content_offset;
+        stats.new_ratings = parsed.num_ratings;
+        stats.watermark = header.max_timestamp;
+        if (!rewriteRatingsSnapshot(snapshot_path, header, users_ratings_log)) {
+            std::cerr << "Aviso: não foi possível gravar o snapshot de avaliações: " << snapshot_path << std::endl;
+        }
+        munmap(file_content, file_size);
+        return stats;
+    }
+
+    // O CSV só cresceu se o trecho já consumido continua idêntico; senão vale o watermark.
+    const bool appended = header.consumed_bytes >= content_offset && header.consumed_bytes <= complete_end &&
+                          fingerprintConsumedInput(file_content, header.consumed_bytes) == header.source_fingerprint;
+    stats.mode = appended ? RatingsIngestionMode::TAIL : RatingsIngestionMode::WATERMARK;
+    const size_t parse_begin = appended ? header.consumed_bytes : content_offset;
+
+    std::pmr::monotonic_buffer_resource new_ratings_arena;
+    UserRatingsLog new_ratings(&new_ratings_arena);
+    RatingsParseResult parsed = parseRatingsLines(file_content + parse_begin, complete_end - parse_begin, new_ratings,
+                                                  true, appended ? -1 : header.max_timestamp);
+    for (const auto& [user_id, ratings] : new_ratings) {
+        UserRatings& merged = users_ratings_log[user_id];
+        merged.insert(merged.end(), ratings.begin(), ratings.end());
+    }
+    stats.bytes_parsed = complete_end - parse_begin;
+    stats.new_ratings = parsed.num_ratings;
+
+    const bool changed = parsed.num_ratings > 0 || header.consumed_bytes != complete_end;
+    header.consumed_bytes = complete_end;
+    header.max_timestamp = std::max(header.max_timestamp, parsed.max_timestamp);
+    header.source_fingerprint = fingerprintConsumedInput(file_content, complete_end);
+    stats.watermark = header.max_timestamp;
+    munmap(file_content, file_size);
+
+    if (changed) {
+        const bool saved = header.num_segments + 1 > static_cast<uint32_t>(std::max(RATINGS_SNAPSHOT_MAX_SEGMENTS, 1))
+            ? rewriteRatingsSnapshot(snapshot_path, header, users_ratings_log)
+            : appendRatingsSnapshotSegment(snapshot_path, header, new_ratings);
+        if (!saved) {
+            std::cerr << "Aviso: não foi possível atualizar o snapshot de avaliações: " << snapshot_path << std::endl;
+        }
+    }
+    return stats;
+}
+
 void countEntityRatings(const UserRatingsLog& users_ratings_log,
                         std::unordered_map<int, int>& user_rating_counts,
                         std::unordered_map<int, int>& movie_rating_counts) {
@@ -236,7 +642,7 @@ void countEntityRatings(const UserRatingsLog& users_ratings_log,
     user_rating_counts.reserve(users_ratings_log.size());
 
     // Converte o mapa para um vetor de ponteiros para facilitar a iteração paralela.
-    std::vector<const std::pair<const int, std::vector<std::pair<int, float>>>*> user_vec;
+    std::vector<const UserRatingsLog::value_type*> user_vec;
     user_vec.reserve(users_ratings_log.size());
     for (const auto& pair : users_ratings_log) {
         user_vec.push_back(&pair);
@@ -332,92 +738,80 @@ void filterUserRatingsLog(const UserRatingsLog& original_log,
         users_to_process.push_back(user_id);
     }
     
-    int num_threads = 1;
-    #ifdef _OPENMP
-        #pragma omp parallel
-        {
-            #pragma omp single
-            num_threads = omp_get_num_threads();
-        }
-    #endif
-    std::vector<UserRatingsLog> local_filtered_logs(num_threads);
-
-    // As threads dividem o trabalho de filtrar as avaliações de cada usuário.
+    // 1. Contagem paralela das avaliações que sobrevivem ao filtro.
+    std::vector<const UserRatings*> original_rows(users_to_process.size());
+    std::vector<uint32_t> kept_counts(users_to_process.size());
     #pragma omp parallel for schedule(dynamic)
-    for(size_t i = 0; i < users_to_process.size(); ++i) {
-        int user_id = users_to_process[i];
-        int thread_id = 0;
-        #ifdef _OPENMP
-            thread_id = omp_get_thread_num();
-        #endif
-
-        const auto& original_ratings = original_log.at(user_id);
-        std::vector<std::pair<int, float>> new_ratings;
-        new_ratings.reserve(original_ratings.size());
-
-        // Mantém apenas as avaliações de filmes que estão na lista de filmes válidos.
+    for (size_t i = 0; i < users_to_process.size(); ++i) {
+        const UserRatings& original_ratings = original_log.at(users_to_process[i]);
+        uint32_t kept = 0;
         for (const auto& rating_pair : original_ratings) {
-            if (valid_movie_ids.count(rating_pair.first)) {
-                new_ratings.push_back(rating_pair);
-            }
-        }
-        // Se o usuário ainda tiver avaliações após o filtro, adiciona ao log local.
-        if (!new_ratings.empty()) {
-            local_filtered_logs[thread_id][user_id] = std::move(new_ratings);
+            kept += valid_movie_ids.count(rating_pair.first) ? 1u : 0u;
         }
+        original_rows[i] = &original_ratings;
+        kept_counts[i] = kept;
     }
-    
-    // Combina os logs filtrados locais em um único log global.
-    for(const auto& local_log : local_filtered_logs) {
-        for(const auto& pair : local_log) {
-            filtered_log.insert(pair);
+
+    // 2. As linhas são criadas em sequência, já com a capacidade exata, no recurso de memória do
+    // log filtrado (uma arena não é thread-safe); usuários sem avaliações restantes ficam de fora.
+    std::vector<UserRatings*> filtered_rows(users_to_process.size(), nullptr);
+    for (size_t i = 0; i < users_to_process.size(); ++i) {
+        if (kept_counts[i] == 0) continue;
+        UserRatings& row = filtered_log[users_to_process[i]];
+        row.reserve(kept_counts[i]);
+        filtered_rows[i] = &row;
+    }
+
+    // 3. Cópia paralela das avaliações mantidas, sem nenhuma alocação.
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < users_to_process.size(); ++i) {
+        UserRatings* row = filtered_rows[i];
+        if (!row) continue;
+        for (const auto& rating_pair : *original_rows[i]) {
+            if (valid_movie_ids.count(rating_pair.first)) row->push_back(rating_pair);
         }
     }
 }
 
 void writeFilteredRatingsToFile(const std::string& output_path, const UserRatingsLog& users_ratings_log) {
-    // Cria um vetor de ponteiros para os usuários para paralelizar a criação das strings.
-    std::vector<const std::pair<const int, std::vector<std::pair<int, float>>>*> user_ptrs;
+    // Cria um vetor de ponteiros para os usuários para paralelizar a formatação.
+    std::vector<const UserRatingsLog::value_type*> user_ptrs;
     user_ptrs.reserve(users_ratings_log.size());
     for (const auto& pair : users_ratings_log) {
         user_ptrs.push_back(&pair);
     }
 
-    std::vector<std::string> output_lines(user_ptrs.size());
+    AsyncFileWriter writer(output_path, OUTPUT_CHUNK_SIZE, OUTPUT_MAX_PENDING_CHUNKS);
+    if (!writer.isOpen()) return;
 
-    // Cada thread gera a string de saída para um subconjunto de usuários.
-    #pragma omp parallel for schedule(dynamic)
-    for (size_t i = 0; i < user_ptrs.size(); ++i) {
-        const auto& user_entry = *user_ptrs[i];
-        std::string line;
-        line.reserve(user_entry.second.size() * 15); // Pre-alocação para performance.
-        line += std::to_string(user_entry.first);
-        for (const auto& rating_pair : user_entry.second) {
-            line += " " + std::to_string(rating_pair.first) + ":" + std::to_string(rating_pair.second);
-        }
-        output_lines[i] = std::move(line);
-    }
+    // Cada thread formata suas linhas com std::to_chars em um chunk próprio e o entrega ao
+    // escritor assim que ele enche. Não há string por linha nem uma string final gigante:
+    // a memória usada fica limitada a alguns chunks, qualquer que seja o tamanho do dataset.
+    // A ordem das linhas entre chunks de threads diferentes não é garantida.
+    #pragma omp parallel
+    {
+        std::string chunk = writer.acquireChunk();
+
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < user_ptrs.size(); ++i) {
+            const auto& user_entry = *user_ptrs[i];
+            appendInt(chunk, user_entry.first);
+            for (const auto& rating_pair : user_entry.second) {
+                chunk += ' ';
+                appendInt(chunk, rating_pair.first);
+                chunk += ':';
+                appendFixed(chunk, rating_pair.second, 6); // Mesmo formato de std::to_string(float)
+            }
+            chunk += '\n';
 
-    std::ofstream outFile(output_path, std::ios::binary);
-    if (!outFile) {
-        std::cerr << "Erro: não foi possível abrir o arquivo de saída: " << output_path << std::endl;
-        return;
-    }
-    
-    // Concatena todas as linhas geradas em uma única string gigante e escreve no arquivo de uma só vez.
-    // Isso minimiza as operações de escrita no disco.
-    std::string final_output;
-    size_t total_size = 0;
-    for(const auto& line : output_lines) {
-        total_size += line.size() + 1; // +1 para o '\n'
-    }
-    final_output.reserve(total_size);
-    
-    for (const auto& line : output_lines) {
-        final_output += line;
-        final_output += '\n';
+            if (chunk.size() >= writer.chunkCapacity()) {
+                writer.submit(std::move(chunk));
+                chunk = writer.acquireChunk();
+            }
+        }
+        if (!chunk.empty()) writer.submit(std::move(chunk));
     }
-    outFile.write(final_output.data(), final_output.size());
+    writer.finish();
 }
 
 
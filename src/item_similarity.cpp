@@ -0,0 +1,272 @@
+#include "../include/item_similarity.hpp"
+#include "../include/recommender_engine.hpp" // Para appendUserOutput
+#include "../include/output_writer.hpp"
+#include "../include/compressed_rows.hpp"
+#include "../include/config.hpp"
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// Cabeçalho do arquivo binário do modelo item-item.
+const char ITEM_MODEL_MAGIC[8] = {'I', 'T', 'E', 'M', 'S', 'I', 'M', '1'};
+
+} // namespace
+
+ItemSimilarityModel buildItemSimilarityModel(const RatingMatrix& matrix, int top_m) {
+    ItemSimilarityModel model;
+    model.top_m = top_m;
+    const int D = matrix.numMovies();
+    const int U = matrix.numUsers();
+    model.dense_idx_to_movie_id = matrix.movies.dense_to_external;
+
+    // 1. Índice invertido filme -> (usuário, nota) em formato CSR, e normas dos filmes.
+    std::vector<uint32_t> column_offsets(D + 1, 0);
+    for (int u = 0; u < U; ++u) {
+        forEachRowEntry(matrix, u, [&](uint32_t, int movie_idx) { column_offsets[movie_idx + 1]++; });
+    }
+    for (int i = 0; i < D; ++i) column_offsets[i + 1] += column_offsets[i];
+
+    std::vector<std::pair<int, float>> column_entries(column_offsets[D]);
+    std::vector<uint32_t> fill_pos(column_offsets.begin(), column_offsets.end() - 1);
+    std::vector<float> item_norms(D, 0.0f);
+    for (int u = 0; u < U; ++u) {
+        forEachRowEntry(matrix, u, [&](uint32_t p, int movie_idx) {
+            float rating = matrix.ratingAt(p);
+            column_entries[fill_pos[movie_idx]++] = {u, rating};
+            item_norms[movie_idx] += rating * rating;
+        });
+    }
+    for (float& norm : item_norms) norm = std::sqrt(norm);
+
+    // 2. Para cada filme, acumula os produtos internos com todos os filmes co-avaliados.
+    std::vector<std::vector<std::pair<int, float>>> top_neighbors(D);
+
+    #pragma omp parallel
+    {
+        // Acumulador denso e lista de posições tocadas, reutilizados entre filmes pela mesma thread.
+        std::vector<float> dot_acc(D, 0.0f);
+        std::vector<int> touched;
+        touched.reserve(D);
+        std::vector<std::pair<int, float>> candidates;
+        candidates.reserve(D);
+
+        #pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < D; ++i) {
+            if (item_norms[i] == 0.0f) continue;
+
+            for (uint32_t c = column_offsets[i]; c < column_offsets[i + 1]; ++c) {
+                const auto& [user_idx, rating_i] = column_entries[c];
+                forEachRowEntry(matrix, user_idx, [&](uint32_t p, int j) {
+                    if (j == i) return;
+                    if (dot_acc[j] == 0.0f) touched.push_back(j);
+                    dot_acc[j] += rating_i * matrix.ratingAt(p);
+                });
+            }
+
+            candidates.clear();
+            for (int j : touched) {
+                float similarity = dot_acc[j] / (item_norms[i] * item_norms[j]);
+                if (similarity > 0.0f) candidates.emplace_back(j, similarity);
+                dot_acc[j] = 0.0f;
+            }
+            touched.clear();
+
+            size_t keep = std::min(candidates.size(), static_cast<size_t>(top_m));
+            std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(),
+                              [](const auto& a, const auto& b) { return a.second > b.second; });
+            top_neighbors[i].assign(candidates.begin(), candidates.begin() + keep);
+        }
+    }
+
+    // 3. Compacta as listas em CSR.
+    model.neighbor_offsets.assign(D + 1, 0);
+    for (int i = 0; i < D; ++i) {
+        model.neighbor_offsets[i + 1] = model.neighbor_offsets[i] + top_neighbors[i].size();
+    }
+    model.neighbor_indices.resize(model.neighbor_offsets[D]);
+    model.neighbor_similarities.resize(model.neighbor_offsets[D]);
+    for (int i = 0; i < D; ++i) {
+        uint32_t pos = model.neighbor_offsets[i];
+        for (const auto& [j, similarity] : top_neighbors[i]) {
+            model.neighbor_indices[pos] = j;
+            model.neighbor_similarities[pos] = similarity;
+            ++pos;
+        }
+    }
+    return model;
+}
+
+bool isItemSimilarityModelCompatible(const ItemSimilarityModel& model, const RatingMatrix& matrix) {
+    if (model.dense_idx_to_movie_id != matrix.movies.dense_to_external) return false;
+    return model.neighbor_offsets.size() == model.dense_idx_to_movie_id.size() + 1;
+}
+
+bool saveItemSimilarityModel(const std::string& output_path, const ItemSimilarityModel& model) {
+    std::ofstream out(output_path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Erro: não foi possível criar o arquivo do modelo item-item: " << output_path << std::endl;
+        return false;
+    }
+    uint64_t num_movies = model.dense_idx_to_movie_id.size();
+    uint64_t num_links = model.neighbor_indices.size();
+    int32_t top_m = model.top_m;
+
+    out.write(ITEM_MODEL_MAGIC, sizeof(ITEM_MODEL_MAGIC));
+    out.write(reinterpret_cast<const char*>(&top_m), sizeof(top_m));
+    out.write(reinterpret_cast<const char*>(&num_movies), sizeof(num_movies));
+    out.write(reinterpret_cast<const char*>(&num_links), sizeof(num_links));
+    out.write(reinterpret_cast<const char*>(model.dense_idx_to_movie_id.data()), num_movies * sizeof(int));
+    out.write(reinterpret_cast<const char*>(model.neighbor_offsets.data()), (num_movies + 1) * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(model.neighbor_indices.data()), num_links * sizeof(int));
+    out.write(reinterpret_cast<const char*>(model.neighbor_similarities.data()), num_links * sizeof(float));
+    return static_cast<bool>(out);
+}
+
+bool loadItemSimilarityModel(const std::string& input_path, ItemSimilarityModel& model) {
+    std::ifstream in(input_path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[sizeof(ITEM_MODEL_MAGIC)];
+    int32_t top_m = 0;
+    uint64_t num_movies = 0, num_links = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&top_m), sizeof(top_m));
+    in.read(reinterpret_cast<char*>(&num_movies), sizeof(num_movies));
+    in.read(reinterpret_cast<char*>(&num_links), sizeof(num_links));
+    if (!in || std::memcmp(magic, ITEM_MODEL_MAGIC, sizeof(magic)) != 0) {
+        std::cerr << "Aviso: arquivo de modelo item-item inválido: " << input_path << std::endl;
+        return false;
+    }
+
+    model.top_m = top_m;
+    model.dense_idx_to_movie_id.resize(num_movies);
+    model.neighbor_offsets.resize(num_movies + 1);
+    model.neighbor_indices.resize(num_links);
+    model.neighbor_similarities.resize(num_links);
+    in.read(reinterpret_cast<char*>(model.dense_idx_to_movie_id.data()), num_movies * sizeof(int));
+    in.read(reinterpret_cast<char*>(model.neighbor_offsets.data()), (num_movies + 1) * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(model.neighbor_indices.data()), num_links * sizeof(int));
+    in.read(reinterpret_cast<char*>(model.neighbor_similarities.data()), num_links * sizeof(float));
+    return static_cast<bool>(in) && model.neighbor_offsets.back() == num_links;
+}
+
+RecommendationList generateRecommendationsItemBased(
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const ItemSimilarityModel& model,
+    int top_n,
+    bool use_user_mean_filter,
+    NeighborSimilarityStats* out_neighbor_stats,
+    const GenreFilter& genre_filter) {
+    if (out_neighbor_stats) *out_neighbor_stats = NeighborSimilarityStats();
+    if (target_user_idx < 0 || target_user_idx >= matrix.numUsers()) return {};
+
+    const int D = static_cast<int>(model.dense_idx_to_movie_id.size());
+
+    // Acumuladores densos por thread, reutilizados entre consultas (sem alocação no caminho quente).
+    thread_local std::vector<float> weighted_score_sum;
+    thread_local std::vector<float> similarity_sum;
+    thread_local std::vector<char> seen;
+    thread_local std::vector<int> touched;
+    if (static_cast<int>(weighted_score_sum.size()) != D) {
+        weighted_score_sum.assign(D, 0.0f);
+        similarity_sum.assign(D, 0.0f);
+        seen.assign(D, 0);
+    }
+    touched.clear();
+
+    float user_mean = 0.0f;
+    forEachRowEntry(matrix, target_user_idx, [&](uint32_t p, int movie_idx) {
+        user_mean += matrix.ratingAt(p);
+        seen[movie_idx] = 1;
+    });
+    if (matrix.rowLength(target_user_idx) > 0) user_mean /= matrix.rowLength(target_user_idx);
+
+    const bool filter_genres = genre_filter.isActive() && !matrix.movie_genres.empty();
+
+    // Percorre o perfil do usuário através das listas top-M: custo O(|perfil| * M).
+    NeighborSimilarityStats link_stats;
+    float similarity_total = 0.0f;
+    forEachRowEntry(matrix, target_user_idx, [&](uint32_t profile_pos, int movie_idx) {
+        const float rating = matrix.ratingAt(profile_pos);
+        for (uint32_t p = model.neighbor_offsets[movie_idx]; p < model.neighbor_offsets[movie_idx + 1]; ++p) {
+            int neighbor_idx = model.neighbor_indices[p];
+            float similarity = model.neighbor_similarities[p];
+            if (link_stats.count == 0 || similarity < link_stats.min) link_stats.min = similarity;
+            if (link_stats.count == 0 || similarity > link_stats.max) link_stats.max = similarity;
+            similarity_total += similarity;
+            ++link_stats.count;
+            if (seen[neighbor_idx]) continue;
+            if (filter_genres && !genre_filter.accepts(matrix.movie_genres[neighbor_idx])) continue;
+            if (similarity_sum[neighbor_idx] == 0.0f) touched.push_back(neighbor_idx);
+            weighted_score_sum[neighbor_idx] += rating * similarity;
+            similarity_sum[neighbor_idx] += similarity;
+        }
+    });
+    if (link_stats.count > 0) link_stats.mean = similarity_total / link_stats.count;
+    if (out_neighbor_stats) *out_neighbor_stats = link_stats;
+
+    // Mesmo critério do motor LSH: exige suporte > 1.0, com fallback para qualquer suporte positivo.
+    RecommendationList recommendations;
+    for (int movie_idx : touched) {
+        if (similarity_sum[movie_idx] > 1.0f) {
+            float predicted_rating = weighted_score_sum[movie_idx] / similarity_sum[movie_idx];
+            if (!use_user_mean_filter || predicted_rating > user_mean) {
+                recommendations.emplace_back(movie_idx, predicted_rating);
+            }
+        }
+    }
+    if (recommendations.empty()) {
+        for (int movie_idx : touched) {
+            if (similarity_sum[movie_idx] > 0.0f) {
+                float predicted_rating = weighted_score_sum[movie_idx] / similarity_sum[movie_idx];
+                recommendations.emplace_back(movie_idx, predicted_rating);
+            }
+        }
+    }
+
+    // Limpa apenas as posições tocadas, deixando os acumuladores prontos para a próxima consulta.
+    for (int movie_idx : touched) {
+        weighted_score_sum[movie_idx] = 0.0f;
+        similarity_sum[movie_idx] = 0.0f;
+    }
+    forEachRowEntry(matrix, target_user_idx, [&](uint32_t, int movie_idx) { seen[movie_idx] = 0; });
+
+    size_t keep = std::min(recommendations.size(), static_cast<size_t>(std::max(top_n, 0)));
+    std::partial_sort(recommendations.begin(), recommendations.begin() + keep, recommendations.end(),
+                      [](const auto& a, const auto& b) { return a.second > b.second; });
+    recommendations.resize(keep);
+    return recommendations;
+}
+
+void generateItemBasedRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RatingMatrix& matrix,
+    const ItemSimilarityModel& model,
+    const MovieCatalog& movie_catalog,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter) {
+
+    streamOrderedUserOutputs(explore_user_ids.size(), [&](size_t idx, std::string& output) {
+        int target_user_id = explore_user_ids[idx];
+        int target_user_idx = matrix.users.toDense(target_user_id);
+        if (target_user_idx < 0) {
+            std::cerr << "Warning: Target user " << target_user_id << " not found for item-item." << std::endl;
+        }
+        NeighborSimilarityStats neighbor_stats;
+        RecommendationList recommendations = generateRecommendationsItemBased(
+            target_user_idx, matrix, model, top_n, true, &neighbor_stats, genre_filter);
+        restoreExternalMovieIds(recommendations, matrix, top_n);
+        appendUserOutput(output, format, target_user_id, neighbor_stats, recommendations, movie_catalog, top_n);
+    }, writer, OUTPUT_USERS_PER_BATCH);
+}
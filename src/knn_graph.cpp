@@ -0,0 +1,280 @@
+#include "../include/knn_graph.hpp"
+#include "../include/recommender_engine.hpp"
+#include "../include/compressed_rows.hpp"
+#include "../include/similarity_policies.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// Similaridade das posições vagas: abaixo de qualquer similaridade (todas em [-1, 1]), então são sempre trocadas primeiro.
+constexpr float EMPTY_SLOT_SIMILARITY = -2.0f;
+
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Listas de vizinhos em construção: um min-heap de K posições por usuário (a raiz é o
+ * pior vizinho), com a marca "novo" do NN-Descent e um spinlock por usuário.
+ */
+class NeighborHeaps {
+public:
+    NeighborHeaps(int num_users, int k)
+        : k_(k),
+          users_(static_cast<size_t>(num_users) * k, -1),
+          similarities_(static_cast<size_t>(num_users) * k, EMPTY_SLOT_SIMILARITY),
+          is_new_(static_cast<size_t>(num_users) * k, 0),
+          locks_(new std::atomic<uint8_t>[num_users]()) {}
+
+    /**
+     * @brief Oferece `candidate` à lista de `user`; devolve true se a lista mudou.
+     */
+    bool offer(int user, int candidate, float similarity) {
+        if (user == candidate) return false;
+        const size_t base = static_cast<size_t>(user) * k_;
+        std::atomic<uint8_t>& lock = locks_[user];
+        while (lock.exchange(1, std::memory_order_acquire)) {
+            while (lock.load(std::memory_order_relaxed)) {}
+        }
+        bool inserted = false;
+        if (similarity > similarities_[base] &&
+            std::find(users_.begin() + base, users_.begin() + base + k_, candidate) == users_.begin() + base + k_) {
+            users_[base] = candidate;
+            similarities_[base] = similarity;
+            is_new_[base] = 1;
+            siftDown(base);
+            inserted = true;
+        }
+        lock.store(0, std::memory_order_release);
+        return inserted;
+    }
+
+    int userAt(int user, int slot) const { return users_[static_cast<size_t>(user) * k_ + slot]; }
+    float similarityAt(int user, int slot) const { return similarities_[static_cast<size_t>(user) * k_ + slot]; }
+    uint8_t& isNewAt(int user, int slot) { return is_new_[static_cast<size_t>(user) * k_ + slot]; }
+
+private:
+    void siftDown(size_t base) {
+        int i = 0;
+        while (true) {
+            const int left = 2 * i + 1;
+            if (left >= k_) break;
+            int smallest = left;
+            const int right = left + 1;
+            if (right < k_ && similarities_[base + right] < similarities_[base + left]) smallest = right;
+            if (similarities_[base + smallest] >= similarities_[base + i]) break;
+            std::swap(users_[base + i], users_[base + smallest]);
+            std::swap(similarities_[base + i], similarities_[base + smallest]);
+            std::swap(is_new_[base + i], is_new_[base + smallest]);
+            i = smallest;
+        }
+    }
+
+    int k_;
+    std::vector<int> users_;
+    std::vector<float> similarities_;
+    std::vector<uint8_t> is_new_;
+    std::unique_ptr<std::atomic<uint8_t>[]> locks_;
+};
+
+// Lista de tamanho fixo por usuário (amostras diretas ou reversas de uma iteração).
+struct SampledLists {
+    int capacity = 0;
+    std::vector<int> users;
+    std::vector<int> counts;
+
+    void reset(int num_users, int list_capacity) {
+        capacity = list_capacity;
+        users.resize(static_cast<size_t>(num_users) * list_capacity);
+        counts.assign(num_users, 0);
+    }
+    void push(int owner, int user) {
+        int& count = counts[owner];
+        if (count < capacity) users[static_cast<size_t>(owner) * capacity + count++] = user;
+    }
+    const int* begin(int owner) const { return users.data() + static_cast<size_t>(owner) * capacity; }
+    const int* end(int owner) const { return begin(owner) + counts[owner]; }
+};
+
+} // namespace
+
+void KnnGraph::neighborsOf(int user_idx, int max_neighbors, NeighborList& out) const {
+    out.clear();
+    if (user_idx < 0 || user_idx >= numUsers()) return;
+    const size_t base = static_cast<size_t>(user_idx) * k;
+    const int limit = std::min(k, max_neighbors);
+    for (int i = 0; i < limit; ++i) {
+        const int neighbor = neighbor_users[base + i];
+        const float similarity = neighbor_similarities[base + i];
+        if (neighbor < 0 || similarity <= 0.0f) break; // Linha em ordem decrescente
+        out.emplace_back(neighbor, similarity);
+    }
+}
+
+KnnGraph buildKnnGraphNNDescent(const RatingMatrix& matrix,
+                                const UserNormsVec& user_norms,
+                                const std::vector<LSHTable>& lsh_tables,
+                                int k,
+                                int max_iterations,
+                                float sample_rate,
+                                float early_stop,
+                                uint64_t seed) {
+    KnnGraph graph;
+    const int U = matrix.numUsers();
+    if (k <= 0 || U < 2) return graph;
+    k = std::min(k, U - 1);
+
+    NeighborHeaps heaps(U, k);
+    auto similarity_of = [&](int a, int b) {
+        return pairSimilarity<ConfiguredSimilarity>(matrix, user_norms, a, b);
+    };
+
+    // 1. Semente: membros sorteados dos buckets do próprio usuário em cada tabela; as posições
+    // que sobrarem (buckets pequenos) recebem usuários aleatórios.
+    const int num_tables = static_cast<int>(lsh_tables.size());
+    const int per_table = num_tables > 0 ? (k + num_tables - 1) / num_tables : 0;
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int u = 0; u < U; ++u) {
+        thread_local std::vector<int> bucket_scratch; // Só usado com buckets comprimidos
+        uint64_t state = splitMix64(seed ^ static_cast<uint64_t>(u));
+        for (int t = 0; t < num_tables; ++t) {
+            const LSHTable& table = lsh_tables[t];
+            if (table.user_buckets.size() != static_cast<size_t>(U)) continue;
+            const uint32_t bucket = table.user_buckets[u];
+            const uint32_t size = table.bucketEnd(bucket) - table.bucketBegin(bucket);
+            if (size <= 1) continue;
+            const int* members = bucketUserIndices(table, bucket, bucket_scratch);
+            for (int s = 0; s < per_table; ++s) {
+                state = splitMix64(state);
+                const int candidate = members[static_cast<uint32_t>(state % size)];
+                if (candidate != u) heaps.offer(u, candidate, similarity_of(u, candidate));
+            }
+        }
+        // Enquanto a raiz (pior posição) estiver vaga, ainda há posições livres.
+        for (int attempts = 0; attempts < 4 * k && heaps.userAt(u, 0) < 0; ++attempts) {
+            state = splitMix64(state);
+            const int candidate = static_cast<int>(state % static_cast<uint64_t>(U));
+            if (candidate != u) heaps.offer(u, candidate, similarity_of(u, candidate));
+        }
+    }
+
+    // 2. Refinamento: junções locais entre vizinhos novos e antigos (diretos e reversos).
+    const int sample_size = std::max(1, std::min(k, static_cast<int>(sample_rate * k + 0.5f)));
+    const long long stop_threshold = static_cast<long long>(early_stop * static_cast<float>(U) * k);
+    SampledLists new_lists, old_lists, reverse_new, reverse_old;
+    for (int iteration = 0; iteration < max_iterations; ++iteration) {
+        new_lists.reset(U, sample_size);
+        old_lists.reset(U, k);
+        reverse_new.reset(U, sample_size);
+        reverse_old.reset(U, sample_size);
+
+        // Amostra dos vizinhos novos de cada usuário: os de menor hash (usuário, vizinho, iteração),
+        // independente da ordem das posições no heap. Os amostrados passam a ser antigos.
+        const uint64_t iteration_seed = splitMix64(seed + static_cast<uint64_t>(iteration) + 1);
+        #pragma omp parallel
+        {
+            std::vector<std::pair<uint64_t, int>> fresh;
+            #pragma omp for schedule(dynamic, 256)
+            for (int u = 0; u < U; ++u) {
+                fresh.clear();
+                for (int slot = 0; slot < k; ++slot) {
+                    const int neighbor = heaps.userAt(u, slot);
+                    if (neighbor < 0) continue;
+                    if (heaps.isNewAt(u, slot)) {
+                        const uint64_t key = splitMix64(iteration_seed ^ (static_cast<uint64_t>(u) << 32) ^ static_cast<uint32_t>(neighbor));
+                        fresh.emplace_back(key, slot);
+                    } else {
+                        old_lists.push(u, neighbor);
+                    }
+                }
+                const size_t taken = std::min(fresh.size(), static_cast<size_t>(sample_size));
+                std::partial_sort(fresh.begin(), fresh.begin() + taken, fresh.end());
+                for (size_t i = 0; i < taken; ++i) {
+                    new_lists.push(u, heaps.userAt(u, fresh[i].second));
+                    heaps.isNewAt(u, fresh[i].second) = 0;
+                }
+            }
+        }
+
+        // Listas reversas (limitadas a sample_size), em ordem de usuário para serem determinísticas.
+        for (int u = 0; u < U; ++u) {
+            for (const int* v = new_lists.begin(u); v != new_lists.end(u); ++v) reverse_new.push(*v, u);
+            for (const int* v = old_lists.begin(u); v != old_lists.end(u); ++v) reverse_old.push(*v, u);
+        }
+
+        long long updates = 0;
+        #pragma omp parallel reduction(+:updates)
+        {
+            std::vector<int> fresh_users, old_users, scratch;
+            #pragma omp for schedule(dynamic, 64)
+            for (int u = 0; u < U; ++u) {
+                fresh_users.assign(new_lists.begin(u), new_lists.end(u));
+                fresh_users.insert(fresh_users.end(), reverse_new.begin(u), reverse_new.end(u));
+                std::sort(fresh_users.begin(), fresh_users.end());
+                fresh_users.erase(std::unique(fresh_users.begin(), fresh_users.end()), fresh_users.end());
+                if (fresh_users.empty()) continue;
+
+                scratch.assign(old_lists.begin(u), old_lists.end(u));
+                scratch.insert(scratch.end(), reverse_old.begin(u), reverse_old.end(u));
+                std::sort(scratch.begin(), scratch.end());
+                scratch.erase(std::unique(scratch.begin(), scratch.end()), scratch.end());
+                old_users.clear();
+                std::set_difference(scratch.begin(), scratch.end(), fresh_users.begin(), fresh_users.end(),
+                                    std::back_inserter(old_users));
+
+                // Pares novo-novo e novo-antigo; antigo-antigo já foi comparado em iterações anteriores.
+                for (size_t i = 0; i < fresh_users.size(); ++i) {
+                    const int p = fresh_users[i];
+                    for (size_t j = i + 1; j < fresh_users.size(); ++j) {
+                        const int q = fresh_users[j];
+                        const float similarity = similarity_of(p, q);
+                        updates += heaps.offer(p, q, similarity) + heaps.offer(q, p, similarity);
+                    }
+                    for (const int q : old_users) {
+                        if (q == p) continue;
+                        const float similarity = similarity_of(p, q);
+                        updates += heaps.offer(p, q, similarity) + heaps.offer(q, p, similarity);
+                    }
+                }
+            }
+        }
+        graph.build_iterations = iteration + 1;
+        if (updates <= stop_threshold) break;
+    }
+
+    // 3. Arranjo final: cada linha em similaridade decrescente.
+    graph.k = k;
+    graph.neighbor_users.assign(static_cast<size_t>(U) * k, -1);
+    graph.neighbor_similarities.assign(static_cast<size_t>(U) * k, 0.0f);
+    #pragma omp parallel
+    {
+        std::vector<std::pair<float, int>> row;
+        #pragma omp for schedule(static)
+        for (int u = 0; u < U; ++u) {
+            row.clear();
+            for (int slot = 0; slot < k; ++slot) {
+                if (heaps.userAt(u, slot) >= 0) row.emplace_back(heaps.similarityAt(u, slot), heaps.userAt(u, slot));
+            }
+            std::sort(row.begin(), row.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+            const size_t base = static_cast<size_t>(u) * k;
+            for (size_t i = 0; i < row.size(); ++i) {
+                graph.neighbor_users[base + i] = row[i].second;
+                graph.neighbor_similarities[base + i] = row[i].first;
+            }
+        }
+    }
+    return graph;
+}
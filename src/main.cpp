@@ -2,6 +2,16 @@
 #include "../include/types.hpp"
 #include "../include/csv_parser.hpp"
 #include "../include/recommender_engine.hpp"
+#include "../include/item_similarity.hpp"
+#include "../include/matrix_factorization.hpp"
+#include "../include/recommendation_cache.hpp"
+#include "../include/output_writer.hpp"
+#include "../include/binary_output.hpp"
+#include "../include/recommender_model.hpp"
+#include "../include/pipeline.hpp"
+#include "../include/memory_placement.hpp"
+#include "../include/sharded_model.hpp"
+#include "../include/shard_workers.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -9,16 +19,24 @@
 #include <string>
 #include <chrono>    
 #include <iomanip>   
-#include <random>
 #include <set>
 #include <unordered_set>
 #include <numeric>
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <future>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
-int main() {
+int main(int argc, char* argv[]) {
+    // O mesmo executável atende como worker de shards quando iniciado por um ShardWorkerPool.
+    if (isShardWorkerInvocation(argc, argv)) {
+        return runShardWorker(argc, argv);
+    }
+
     auto program_start_time = std::chrono::high_resolution_clock::now();
 
     // #ifdef _OPENMP
@@ -31,27 +49,56 @@ int main() {
     // std::cout << "Iniciando Sistema de Recomendação de Filmes LSH..." << std::endl;
     // std::cout << "----------------------------------------" << std::endl;
 
+    // Opcional: afinidade fixa para as threads OpenMP (os blocos estáticos ficam nos mesmos núcleos).
+    if (PIN_OPENMP_THREADS) pinOpenMPThreads();
+
     // --- 1. Carregamento e Pré-processamento de Dados ---
     auto phase_start_time = std::chrono::high_resolution_clock::now();
     
-    UserRatingsLog raw_users_ratings;
-    readRatingsCSV(RATINGS_CSV_PATH, raw_users_ratings);
+    // Estágios independentes das avaliações começam já: títulos e IDs de explore.dat são lidos
+    // enquanto o CSV de avaliações é processado nesta thread (o caminho crítico).
+    std::future<MovieCatalog> movie_catalog_stage = startPipelineStage([] {
+        return readMovieCatalog(MOVIES_CSV_PATH);
+    });
+    std::future<std::vector<int>> explore_ids_stage;
+    if (!RECOMMEND_ALL_USERS) {
+        explore_ids_stage = startPipelineStage([] { return loadExploreUserIds(EXPLORE_USERS_PATH); });
+    }
 
-    MovieTitlesMap movie_titles = readMovieTitles(MOVIES_CSV_PATH);
+    // Arenas da ingestão: cada log de avaliações (nós, buckets e linhas) ocupa poucos blocos
+    // grandes. O log bruto e sua arena são descartados juntos ao fim do bloco; o filtrado vive
+    // até o fim da execução (a arena é declarada antes para ser destruída depois do log).
+    std::pmr::monotonic_buffer_resource filtered_ratings_arena;
+    UserRatingsLog filtered_users_ratings(&filtered_ratings_arena);
+    std::unordered_set<int> valid_movie_ids;
+    {
+        std::pmr::monotonic_buffer_resource raw_ratings_arena;
+        UserRatingsLog raw_users_ratings(&raw_ratings_arena);
+        if (INCREMENTAL_RATINGS_INGESTION) {
+            RatingsIngestionStats ingestion = readRatingsCSVIncremental(RATINGS_CSV_PATH, RATINGS_SNAPSHOT_PATH,
+                                                                        raw_users_ratings);
+            const char* mode = ingestion.mode == RatingsIngestionMode::TAIL ? "trecho novo"
+                             : ingestion.mode == RatingsIngestionMode::WATERMARK ? "watermark" : "completa";
+            std::cout << "Ingestão incremental (" << mode << "): " << ingestion.new_ratings << " avaliações novas em "
+                      << ingestion.bytes_parsed << " bytes lidos, watermark " << ingestion.watermark << "." << std::endl;
+        } else {
+            readRatingsCSV(RATINGS_CSV_PATH, raw_users_ratings);
+        }
 
-    std::unordered_map<int, int> user_rating_counts, movie_rating_counts;
-    countEntityRatings(raw_users_ratings, user_rating_counts, movie_rating_counts);
-    
-    std::unordered_set<int> valid_user_ids, valid_movie_ids;
-    identifyValidEntities(user_rating_counts, movie_rating_counts, MIN_RATINGS_PER_ENTITY, valid_user_ids, valid_movie_ids);
-    
-    UserRatingsLog filtered_users_ratings;
-    filterUserRatingsLog(raw_users_ratings, valid_user_ids, valid_movie_ids, filtered_users_ratings);
-    
-    raw_users_ratings.clear(); 
-    raw_users_ratings.rehash(0);
+        std::unordered_map<int, int> user_rating_counts, movie_rating_counts;
+        countEntityRatings(raw_users_ratings, user_rating_counts, movie_rating_counts);
+
+        std::unordered_set<int> valid_user_ids;
+        identifyValidEntities(user_rating_counts, movie_rating_counts, MIN_RATINGS_PER_ENTITY, valid_user_ids, valid_movie_ids);
+
+        filterUserRatingsLog(raw_users_ratings, valid_user_ids, valid_movie_ids, filtered_users_ratings);
+    }
     
-    writeFilteredRatingsToFile(FILTERED_DATASET_PATH, filtered_users_ratings);
+    // Ninguém lê o dataset filtrado nesta execução: a gravação corre em paralelo com o índice
+    // (ambos só leem filtered_users_ratings, que vive mais que o estágio).
+    std::future<void> filtered_dump_stage = startPipelineStage([&filtered_users_ratings] {
+        writeFilteredRatingsToFile(FILTERED_DATASET_PATH, filtered_users_ratings);
+    });
     
     // writeRandomUserIdsToExplore(filtered_users_ratings, NUM_RANDOM_USERS_TO_EXPLORE, EXPLORE_USERS_PATH);
 
@@ -61,58 +108,147 @@ int main() {
     // --- 2. Construção da Matriz e Indexação LSH ---
     phase_start_time = std::chrono::high_resolution_clock::now();
 
-    UserItemMatrix user_item_matrix = convertToUserItemMatrix(filtered_users_ratings);
-
-    MovieIdToDenseIdxMap movie_to_idx;
-    int dense_idx_counter = 0;
-    movie_to_idx.reserve(valid_movie_ids.size());
-    for(int movie_id : valid_movie_ids) {
-        movie_to_idx[movie_id] = dense_idx_counter++;
+    // Modelo imutável com matriz, normas, hiperplanos, tabelas LSH, assinaturas e grafo kNN.
+    std::shared_ptr<const RecommenderModel> model = RecommenderModelBuilder()
+        .setRatings(filtered_users_ratings, valid_movie_ids)
+        .setMovieCatalog(movie_catalog_stage.get())
+        .build();
+    if (!model) {
+        return 1;
     }
-    const int D = movie_to_idx.size();    
-
-    UserNormsMap user_norms = computeUserNorms(user_item_matrix);
-    
-    std::mt19937 rng(42);
-    std::vector<HyperplaneSet> all_hyperplane_sets;
-    all_hyperplane_sets.reserve(NUM_LSH_TABLES);
-    for (int i = 0; i < NUM_LSH_TABLES; ++i) {
-        all_hyperplane_sets.push_back(generateSingleHyperplaneSet(NUM_HYPERPLANES_PER_TABLE, D, rng));
+    const RatingMatrix& rating_matrix = model->ratingMatrix();
+    const MovieCatalog& catalog = model->movieCatalog();
+    if (const KnnGraph* knn_graph = model->knnGraphOrNull()) {
+        std::cout << "Grafo kNN (NN-Descent): " << knn_graph->numUsers() << " usuários, K = " << knn_graph->k
+                  << ", " << knn_graph->build_iterations << " iterações." << std::endl;
     }
     
-
-    std::vector<LSHBucketMap> lsh_tables;
-
-    buildLSHTables(user_item_matrix, all_hyperplane_sets, movie_to_idx, lsh_tables);
-    
     phase_end_time = std::chrono::high_resolution_clock::now();
     phase_elapsed = phase_end_time - phase_start_time;
     phase_start_time = std::chrono::high_resolution_clock::now();
     
-    std::vector<int> explore_user_ids = loadExploreUserIds(EXPLORE_USERS_PATH);
+    // Job offline: todos os usuários, agrupados por bucket LSH para reaproveitar as linhas em cache.
+    std::vector<int> explore_user_ids = RECOMMEND_ALL_USERS ? bucketLocalityUserOrder(*model)
+                                                            : explore_ids_stage.get();
     if (explore_user_ids.empty()) {
         std::cerr << "Nenhum usuário para processar no arquivo de exploração." << std::endl;
         return 1;
     }
     
-    std::vector<std::string> user_outputs = generateRecommendationsForUsers(
-        explore_user_ids, user_item_matrix, user_norms,
-        all_hyperplane_sets, lsh_tables, movie_to_idx, movie_titles,
-        K_NEIGHBORS, TOP_N_RECOMMENDATIONS);
-
-    std::ofstream recommendationsOutputFile(OUTPUT_RECOMMENDATIONS_PATH);
-    if (!recommendationsOutputFile) {
-        std::cerr << "Erro: não foi possível abrir o arquivo de saída de recomendações: " << OUTPUT_RECOMMENDATIONS_PATH << std::endl;
+    // As recomendações são gravadas em ordem, por um thread em segundo plano, enquanto são calculadas.
+    GenreFilter genre_filter;
+    genre_filter.include_mask = parseGenreMask(RECOMMENDATION_INCLUDE_GENRES);
+    genre_filter.exclude_mask = parseGenreMask(RECOMMENDATION_EXCLUDE_GENRES);
+
+    const bool binary_output = RECOMMENDATIONS_OUTPUT_FORMAT == RecommendationsOutputFormat::BINARY;
+    const std::string& recommendations_path = RECOMMEND_ALL_USERS
+        ? (binary_output ? ALL_USERS_RECOMMENDATIONS_BINARY_PATH : ALL_USERS_RECOMMENDATIONS_PATH)
+        : (binary_output ? OUTPUT_RECOMMENDATIONS_BINARY_PATH : OUTPUT_RECOMMENDATIONS_PATH);
+    AsyncFileWriter recommendations_writer(recommendations_path, OUTPUT_CHUNK_SIZE, OUTPUT_MAX_PENDING_CHUNKS);
+    if (!recommendations_writer.isOpen()) {
+        std::cerr << "Erro: não foi possível abrir o arquivo de saída de recomendações: " << recommendations_path << std::endl;
         return 1;
     }
+    if (binary_output) {
+        // Um registro por ID de explore.dat (inclusive duplicados e usuários sem recomendações).
+        std::string header_chunk;
+        appendBinaryRecommendationsHeader(header_chunk, makeBinaryRecommendationsHeader(
+            explore_user_ids.size(), TOP_N_RECOMMENDATIONS, static_cast<uint32_t>(RECOMMENDER_ENGINE),
+            K_NEIGHBORS, NUM_LSH_TABLES, NUM_HYPERPLANES_PER_TABLE));
+        recommendations_writer.submit(std::move(header_chunk));
+    }
 
-    for (const auto& out : user_outputs) {
-        recommendationsOutputFile << out;
+    if (RECOMMENDER_ENGINE == RecommenderEngineType::ITEM_ITEM) {
+        // O modelo item-item é um artefato offline: reaproveita o arquivo salvo se for compatível.
+        ItemSimilarityModel item_model;
+        if (!loadItemSimilarityModel(ITEM_SIMILARITY_MODEL_PATH, item_model) ||
+            item_model.top_m != ITEM_SIMILARITY_TOP_M ||
+            !isItemSimilarityModelCompatible(item_model, rating_matrix)) {
+            item_model = buildItemSimilarityModel(rating_matrix, ITEM_SIMILARITY_TOP_M);
+            saveItemSimilarityModel(ITEM_SIMILARITY_MODEL_PATH, item_model);
+        }
+        generateItemBasedRecommendationsForUsers(
+            explore_user_ids, rating_matrix, item_model,
+            catalog, TOP_N_RECOMMENDATIONS, recommendations_writer,
+            RECOMMENDATIONS_OUTPUT_FORMAT, genre_filter);
+    } else if (RECOMMENDER_ENGINE == RecommenderEngineType::MATRIX_FACTORIZATION) {
+        MatrixFactorizationModel mf_model = trainMatrixFactorization(
+            rating_matrix, MF_NUM_FACTORS, MF_NUM_EPOCHS,
+            MF_LEARNING_RATE, MF_REGULARIZATION);
+        generateMFRecommendationsForUsers(
+            explore_user_ids, rating_matrix, mf_model,
+            catalog, TOP_N_RECOMMENDATIONS, recommendations_writer,
+            RECOMMENDATIONS_OUTPUT_FORMAT, genre_filter);
+    } else if (USE_SHARDED_MODEL) {
+        // O modelo em memória só é usado para gravar os shards; as consultas leem os arquivos mapeados.
+        ShardedModel sharded_model;
+        if (SIMILARITY_METRIC != SimilarityMetric::COSINE) {
+            std::cerr << "Aviso: o modelo em shards usa sempre o cosseno; SIMILARITY_METRIC é ignorada." << std::endl;
+        }
+        if (!writeShardedModel(*model, SHARDED_MODEL_DIRECTORY, NUM_MODEL_SHARDS) ||
+            !sharded_model.open(SHARDED_MODEL_DIRECTORY)) {
+            return 1;
+        }
+        if (NUM_SHARD_WORKERS > 0) {
+            // O coordenador só lê as linhas dos alvos; vizinhos e notas ficam com os workers.
+            ShardWorkerPool shard_workers;
+            if (!shard_workers.start(SHARDED_MODEL_DIRECTORY, NUM_SHARD_WORKERS)) {
+                return 1;
+            }
+            auto query_start_time = std::chrono::high_resolution_clock::now();
+            if (!generateRecommendationsForUsers(
+                    explore_user_ids, sharded_model, shard_workers, catalog,
+                    K_NEIGHBORS, TOP_N_RECOMMENDATIONS, recommendations_writer,
+                    RECOMMENDATIONS_OUTPUT_FORMAT, genre_filter)) {
+                return 1;
+            }
+            std::chrono::duration<double> query_elapsed = std::chrono::high_resolution_clock::now() - query_start_time;
+            std::cout << "Workers de shards: " << shard_workers.numWorkers() << " processos, "
+                      << std::fixed << std::setprecision(0)
+                      << explore_user_ids.size() / std::max(query_elapsed.count(), 1e-9)
+                      << " usuários/s." << std::endl;
+        } else {
+            generateRecommendationsForUsers(
+                explore_user_ids, sharded_model, catalog,
+                K_NEIGHBORS, TOP_N_RECOMMENDATIONS, recommendations_writer,
+                RECOMMENDATIONS_OUTPUT_FORMAT, genre_filter);
+            ShardedQueryStats stats = sharded_model.stats();
+            std::cout << "Modelo em shards: " << sharded_model.numShards() << " shards, média de "
+                      << std::fixed << std::setprecision(2) << stats.averageShardsTouched()
+                      << " shards visitados por consulta." << std::endl;
+        }
+    } else {
+        std::unique_ptr<RecommendationCache> cache;
+        // No job de todos os usuários cada usuário aparece uma única vez: o cache não ajudaria.
+        if (RECOMMENDATION_CACHE_CAPACITY > 0 && !RECOMMEND_ALL_USERS) {
+            cache = std::make_unique<RecommendationCache>(RECOMMENDATION_CACHE_CAPACITY);
+        }
+        generateRecommendationsForUsers(
+            explore_user_ids, *model,
+            K_NEIGHBORS, TOP_N_RECOMMENDATIONS, recommendations_writer,
+            RECOMMENDATIONS_OUTPUT_FORMAT, genre_filter, cache.get());
+        if (cache) {
+            RecommendationCacheStats stats = cache->stats();
+            std::cout << "Cache de recomendações: " << stats.recommendation_hits << " acertos, "
+                      << stats.recommendation_misses << " faltas (taxa de acerto "
+                      << std::fixed << std::setprecision(1) << stats.recommendationHitRate() * 100.0 << "%)." << std::endl;
+        }
     }
+
+    if (!recommendations_writer.finish()) {
+        return 1;
+    }
+    filtered_dump_stage.wait();
     // std::cout << "Recomendações LSH escritas em: " << OUTPUT_RECOMMENDATIONS_PATH << std::endl;
 
     phase_end_time = std::chrono::high_resolution_clock::now();
     phase_elapsed = phase_end_time - phase_start_time;
+    if (RECOMMEND_ALL_USERS) {
+        std::cout << "Job de todos os usuários: " << explore_user_ids.size() << " usuários em "
+                  << std::fixed << std::setprecision(2) << phase_elapsed.count() << " segundos ("
+                  << std::setprecision(0) << explore_user_ids.size() / std::max(phase_elapsed.count(), 1e-9)
+                  << " usuários/s)." << std::endl;
+    }
     // std::cout << "Fase 3 concluída em " << std::fixed << std::setprecision(2) << phase_elapsed.count() << " segundos." << std::endl;
    
     auto program_end_time = std::chrono::high_resolution_clock::now();
@@ -0,0 +1,208 @@
+#include "../include/matrix_factorization.hpp"
+#include "../include/recommender_engine.hpp" // Para appendUserOutput
+#include "../include/output_writer.hpp"
+#include "../include/compressed_rows.hpp"
+#include "../include/config.hpp"
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <iostream>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// Uma avaliação já convertida para índices densos, pronta para o SGD.
+struct MFTrainingSample {
+    int user_row;
+    int item_idx;
+    float rating;
+};
+
+// Produto interno de duas linhas de fatores alinhadas em 64 bytes (comprimento múltiplo de 16).
+inline float alignedDot(const float* a, const float* b, int length) {
+    const float* pa = static_cast<const float*>(__builtin_assume_aligned(a, SIMD_ALIGNMENT));
+    const float* pb = static_cast<const float*>(__builtin_assume_aligned(b, SIMD_ALIGNMENT));
+    float sum = 0.0f;
+    #pragma omp simd reduction(+:sum)
+    for (int f = 0; f < length; ++f) {
+        sum += pa[f] * pb[f];
+    }
+    return sum;
+}
+
+// Score atribuído a filmes já vistos. Não usamos -inf porque o projeto compila com -ffast-math.
+constexpr float SEEN_MOVIE_SCORE = std::numeric_limits<float>::lowest();
+
+} // namespace
+
+MatrixFactorizationModel trainMatrixFactorization(const RatingMatrix& matrix,
+                                                  int num_factors,
+                                                  int num_epochs,
+                                                  float learning_rate,
+                                                  float regularization) {
+    MatrixFactorizationModel model;
+    model.num_factors = num_factors;
+    const int floats_per_line = static_cast<int>(SIMD_ALIGNMENT / sizeof(float));
+    model.stride = ((num_factors + floats_per_line - 1) / floats_per_line) * floats_per_line;
+
+    const int D = matrix.numMovies();
+    const int num_users = matrix.numUsers();
+    model.dense_idx_to_movie_id = matrix.movies.dense_to_external;
+
+    // As linhas de fatores são os índices densos da matriz: as amostras saem direto do CSR.
+    std::vector<MFTrainingSample> samples;
+    samples.reserve(matrix.numRatings());
+    double rating_sum = 0.0;
+    for (int u = 0; u < num_users; ++u) {
+        forEachRowEntry(matrix, u, [&](uint32_t p, int movie_idx) {
+            samples.push_back({u, movie_idx, matrix.ratingAt(p)});
+            rating_sum += matrix.ratingAt(p);
+        });
+    }
+    model.global_mean = samples.empty() ? 0.0f : static_cast<float>(rating_sum / samples.size());
+
+    // Inicialização aleatória pequena dos fatores; o padding permanece zerado.
+    model.user_factors.assign(static_cast<size_t>(num_users) * model.stride, 0.0f);
+    model.item_factors.assign(static_cast<size_t>(D) * model.stride, 0.0f);
+    model.user_bias.assign(num_users, 0.0f);
+    model.item_bias.assign(D, 0.0f);
+
+    std::mt19937 rng(42);
+    std::normal_distribution<float> distribution(0.0f, 0.1f);
+    for (int u = 0; u < num_users; ++u) {
+        for (int f = 0; f < num_factors; ++f) model.user_factors[static_cast<size_t>(u) * model.stride + f] = distribution(rng);
+    }
+    for (int i = 0; i < D; ++i) {
+        for (int f = 0; f < num_factors; ++f) model.item_factors[static_cast<size_t>(i) * model.stride + f] = distribution(rng);
+    }
+
+    // Embaralha uma vez: cada thread recebe um trecho contíguo com usuários e itens misturados.
+    std::shuffle(samples.begin(), samples.end(), rng);
+
+    float* user_factors = model.user_factors.data();
+    float* item_factors = model.item_factors.data();
+    float* user_bias = model.user_bias.data();
+    float* item_bias = model.item_bias.data();
+    const float mu = model.global_mean;
+    const int stride = model.stride;
+
+    for (int epoch = 0; epoch < num_epochs; ++epoch) {
+        // Hogwild: atualizações sem locks. Conflitos (mesmo usuário/item em duas threads ao mesmo
+        // tempo) são raros em matrizes esparsas e apenas adicionam um pequeno ruído ao gradiente.
+        #pragma omp parallel for schedule(static)
+        for (size_t s = 0; s < samples.size(); ++s) {
+            const MFTrainingSample& sample = samples[s];
+            float* p = user_factors + static_cast<size_t>(sample.user_row) * stride;
+            float* q = item_factors + static_cast<size_t>(sample.item_idx) * stride;
+
+            float prediction = mu + user_bias[sample.user_row] + item_bias[sample.item_idx] + alignedDot(p, q, stride);
+            float error = sample.rating - prediction;
+
+            user_bias[sample.user_row] += learning_rate * (error - regularization * user_bias[sample.user_row]);
+            item_bias[sample.item_idx] += learning_rate * (error - regularization * item_bias[sample.item_idx]);
+
+            #pragma omp simd
+            for (int f = 0; f < stride; ++f) {
+                float p_f = p[f];
+                float q_f = q[f];
+                p[f] += learning_rate * (error * q_f - regularization * p_f);
+                q[f] += learning_rate * (error * p_f - regularization * q_f);
+            }
+        }
+    }
+    return model;
+}
+
+RecommendationList generateRecommendationsMF(
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const MatrixFactorizationModel& model,
+    int top_n,
+    NeighborSimilarityStats* out_neighbor_stats,
+    const GenreFilter& genre_filter) {
+    if (out_neighbor_stats) *out_neighbor_stats = NeighborSimilarityStats();
+    if (target_user_idx < 0 || target_user_idx >= matrix.numUsers() ||
+        static_cast<size_t>(target_user_idx) >= model.user_bias.size()) {
+        return {};
+    }
+    const int D = static_cast<int>(model.dense_idx_to_movie_id.size());
+    const int stride = model.stride;
+    const float* p = model.user_factors.data() + static_cast<size_t>(target_user_idx) * stride;
+    const float base_score = model.global_mean + model.user_bias[target_user_idx];
+
+    // Scores densos reutilizados pela thread; filmes vistos ou rejeitados pelo filtro de gêneros
+    // recebem SEEN_MOVIE_SCORE e nunca entram no top-N.
+    thread_local std::vector<float> scores;
+    scores.resize(D);
+    const bool filter_genres = genre_filter.isActive() && !matrix.movie_genres.empty();
+    for (int i = 0; i < D; ++i) {
+        if (filter_genres && !genre_filter.accepts(matrix.movie_genres[i])) {
+            scores[i] = SEEN_MOVIE_SCORE;
+            continue;
+        }
+        scores[i] = base_score + model.item_bias[i] + alignedDot(p, model.item_factors.data() + static_cast<size_t>(i) * stride, stride);
+    }
+    forEachRowEntry(matrix, target_user_idx, [&](uint32_t, int movie_idx) {
+        if (movie_idx < D) scores[movie_idx] = SEEN_MOVIE_SCORE;
+    });
+
+    std::vector<int> order(D);
+    for (int i = 0; i < D; ++i) order[i] = i;
+    size_t keep = std::min(static_cast<size_t>(D), static_cast<size_t>(std::max(top_n, 0)));
+    std::partial_sort(order.begin(), order.begin() + keep, order.end(),
+                      [&](int a, int b) { return scores[a] > scores[b]; });
+
+    RecommendationList recommendations;
+    recommendations.reserve(keep);
+    NeighborSimilarityStats cosine_stats;
+    float cosine_sum = 0.0f;
+    float user_norm = std::sqrt(alignedDot(p, p, stride));
+    for (size_t r = 0; r < keep; ++r) {
+        int item_idx = order[r];
+        if (scores[item_idx] == SEEN_MOVIE_SCORE) break;
+        // Nota prevista limitada à escala de avaliações do MovieLens.
+        float predicted_rating = std::min(5.0f, std::max(0.5f, scores[item_idx]));
+        recommendations.emplace_back(item_idx, predicted_rating);
+
+        const float* q = model.item_factors.data() + static_cast<size_t>(item_idx) * stride;
+        float item_norm = std::sqrt(alignedDot(q, q, stride));
+        if (user_norm > 0.0f && item_norm > 0.0f) {
+            float cosine = alignedDot(p, q, stride) / (user_norm * item_norm);
+            if (cosine_stats.count == 0 || cosine < cosine_stats.min) cosine_stats.min = cosine;
+            if (cosine_stats.count == 0 || cosine > cosine_stats.max) cosine_stats.max = cosine;
+            cosine_sum += cosine;
+            ++cosine_stats.count;
+        }
+    }
+    if (cosine_stats.count > 0) cosine_stats.mean = cosine_sum / cosine_stats.count;
+    if (out_neighbor_stats) *out_neighbor_stats = cosine_stats;
+    return recommendations;
+}
+
+void generateMFRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RatingMatrix& matrix,
+    const MatrixFactorizationModel& model,
+    const MovieCatalog& movie_catalog,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter) {
+
+    streamOrderedUserOutputs(explore_user_ids.size(), [&](size_t idx, std::string& output) {
+        int target_user_id = explore_user_ids[idx];
+        int target_user_idx = matrix.users.toDense(target_user_id);
+        if (target_user_idx < 0) {
+            std::cerr << "Warning: Target user " << target_user_id << " not found for matrix factorization." << std::endl;
+        }
+        NeighborSimilarityStats neighbor_stats;
+        RecommendationList recommendations = generateRecommendationsMF(
+            target_user_idx, matrix, model, top_n, &neighbor_stats, genre_filter);
+        restoreExternalMovieIds(recommendations, matrix, top_n);
+        appendUserOutput(output, format, target_user_id, neighbor_stats, recommendations, movie_catalog, top_n);
+    }, writer, OUTPUT_USERS_PER_BATCH);
+}
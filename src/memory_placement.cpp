@@ -0,0 +1,127 @@
+#include "../include/memory_placement.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25 // Linux 6.1+
+#endif
+
+namespace {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+constexpr int MAX_NUMA_NODES = 64; // Máscara de nós em uma palavra
+
+size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// mbind sem libnuma: a região [begin, end) precisa começar em fronteira de página.
+bool bindRange(uintptr_t begin, uintptr_t end, int mode, unsigned long node_mask) {
+    if (begin >= end) return true;
+    const long result = syscall(SYS_mbind, reinterpret_cast<void*>(begin), end - begin, mode,
+                                &node_mask, static_cast<unsigned long>(MAX_NUMA_NODES), MPOL_MF_MOVE);
+    return result == 0;
+}
+
+} // namespace
+
+int numaNodeCount() {
+    static const int count = [] {
+        // Formato "0" ou "0-3" (nós contíguos, o caso comum em servidores).
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string range;
+        if (!(online >> range)) return 1;
+        const size_t dash = range.find('-');
+        const int last = std::atoi(dash == std::string::npos ? range.c_str() : range.c_str() + dash + 1);
+        return std::clamp(last + 1, 1, MAX_NUMA_NODES);
+    }();
+    return count;
+}
+
+bool placeReadMostlyMemory(const void* data, size_t bytes, MemoryPlacementPolicy policy, bool huge_pages) {
+    if (!data || bytes == 0) return true;
+    // Páginas inteiras que cobrem o array (a política também vale para vizinhos na mesma página).
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(pageSize() - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes + pageSize() - 1) & ~(pageSize() - 1);
+    bool ok = true;
+
+    const int nodes = numaNodeCount();
+    if (nodes > 1 && policy == MemoryPlacementPolicy::INTERLEAVE) {
+        const unsigned long all_nodes = nodes == 64 ? ~0UL : ((1UL << nodes) - 1);
+        ok = bindRange(begin, end, MPOL_INTERLEAVE, all_nodes) && ok;
+    } else if (nodes > 1 && policy == MemoryPlacementPolicy::NODE_BLOCKS) {
+        const size_t pages = (end - begin) / pageSize();
+        for (int node = 0; node < nodes; ++node) {
+            const uintptr_t block_begin = begin + (pages * node / nodes) * pageSize();
+            const uintptr_t block_end = begin + (pages * (node + 1) / nodes) * pageSize();
+            ok = bindRange(block_begin, block_end, MPOL_BIND, 1UL << node) && ok;
+        }
+    }
+
+    if (huge_pages) {
+        // Só regiões alinhadas a 2 MB podem virar huge pages; arrays pequenos são ignorados.
+        const uintptr_t huge_begin = (begin + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        const uintptr_t huge_end = end & ~(HUGE_PAGE_SIZE - 1);
+        if (huge_begin < huge_end) {
+            void* region = reinterpret_cast<void*>(huge_begin);
+            ok = madvise(region, huge_end - huge_begin, MADV_HUGEPAGE) == 0 && ok;
+            // EINVAL: kernel sem MADV_COLLAPSE; o khugepaged consolida as páginas mais tarde.
+            if (madvise(region, huge_end - huge_begin, MADV_COLLAPSE) != 0 && errno != EINVAL) ok = false;
+        }
+    }
+    if (!ok) {
+        std::cerr << "Aviso: posicionamento de memória não aplicado a " << bytes << " bytes ("
+                  << std::strerror(errno) << ")." << std::endl;
+    }
+    return ok;
+}
+
+void adviseMappedInput(void* data, size_t bytes) {
+    if (!data || bytes == 0) return;
+    madvise(data, bytes, MADV_WILLNEED);
+    if (USE_HUGE_PAGES) madvise(data, bytes, MADV_HUGEPAGE);
+}
+
+int pinOpenMPThreads() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return 0;
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+    }
+    if (cpus.empty()) return 0;
+
+    int pinned = 0;
+    #pragma omp parallel reduction(+:pinned)
+    {
+        int thread_id = 0;
+        #ifdef _OPENMP
+            thread_id = omp_get_thread_num();
+        #endif
+        if (thread_id > 0) {
+            cpu_set_t target;
+            CPU_ZERO(&target);
+            CPU_SET(cpus[thread_id % cpus.size()], &target);
+            pinned += pthread_setaffinity_np(pthread_self(), sizeof(target), &target) == 0 ? 1 : 0;
+        }
+    }
+    return pinned;
+}
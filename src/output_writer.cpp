@@ -0,0 +1,93 @@
+#include "../include/output_writer.hpp"
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+AsyncFileWriter::AsyncFileWriter(const std::string& output_path, size_t chunk_capacity, size_t max_pending_chunks)
+    : chunk_capacity_(chunk_capacity), max_pending_chunks_(max_pending_chunks ? max_pending_chunks : 1) {
+    fd_ = open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ == -1) {
+        std::cerr << "Erro: não foi possível abrir o arquivo de saída: " << output_path << std::endl;
+        return;
+    }
+    writer_thread_ = std::thread(&AsyncFileWriter::writerLoop, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    finish();
+}
+
+std::string AsyncFileWriter::acquireChunk() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_chunks_.empty()) {
+            std::string chunk = std::move(free_chunks_.back());
+            free_chunks_.pop_back();
+            return chunk;
+        }
+    }
+    // Pool vazio: cria um chunk novo. Reservamos uma folga para que a última linha
+    // anexada antes de atingir a capacidade não provoque realocação.
+    std::string chunk;
+    chunk.reserve(chunk_capacity_ + chunk_capacity_ / 4);
+    return chunk;
+}
+
+void AsyncFileWriter::submit(std::string&& chunk) {
+    if (fd_ == -1) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    has_room_.wait(lock, [this] { return pending_.size() < max_pending_chunks_; });
+    pending_.push_back(std::move(chunk));
+    has_pending_.notify_one();
+}
+
+void AsyncFileWriter::writerLoop() {
+    for (;;) {
+        std::string chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            has_pending_.wait(lock, [this] { return !pending_.empty() || closing_; });
+            if (pending_.empty()) return; // closing_ e nada pendente
+            chunk = std::move(pending_.front());
+            pending_.pop_front();
+            has_room_.notify_one();
+        }
+
+        // Grava o chunk inteiro, tratando escritas parciais.
+        const char* data = chunk.data();
+        size_t remaining = chunk.size();
+        while (remaining > 0) {
+            ssize_t written = write(fd_, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                break;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+
+        // Devolve o buffer ao pool mantendo a capacidade alocada.
+        chunk.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_chunks_.push_back(std::move(chunk));
+    }
+}
+
+bool AsyncFileWriter::finish() {
+    if (fd_ == -1) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    has_pending_.notify_all();
+    if (writer_thread_.joinable()) writer_thread_.join();
+
+    bool ok = !failed_;
+    if (close(fd_) != 0) ok = false;
+    fd_ = -1;
+    if (!ok) std::cerr << "Erro: falha ao gravar o arquivo de saída." << std::endl;
+    return ok;
+}
@@ -0,0 +1,163 @@
+#include "../include/recommendation_cache.hpp"
+#include <algorithm>
+#include <mutex>
+
+RecommendationCache::RecommendationCache(size_t capacity, size_t num_shards)
+    : num_shards_(std::max<size_t>(1, num_shards)) {
+    shards_.reset(new Shard[num_shards_]);
+    // Distribui a capacidade entre os shards (cada shard guarda pelo menos um usuário).
+    size_t per_shard = std::max<size_t>(1, (capacity + num_shards_ - 1) / num_shards_);
+    for (size_t s = 0; s < num_shards_; ++s) {
+        shards_[s].capacity = per_shard;
+        shards_[s].slots.reset(new Slot[per_shard]);
+        shards_[s].slot_of_user.reserve(per_shard);
+    }
+}
+
+RecommendationCache::Shard& RecommendationCache::shardFor(int user_id) const {
+    // Mistura os bits do ID para que IDs sequenciais não caiam sempre no mesmo shard.
+    uint32_t h = static_cast<uint32_t>(user_id) * 2654435761u;
+    return shards_[h % num_shards_];
+}
+
+RecommendationCache::Slot& RecommendationCache::acquireSlot(Shard& shard, int user_id) {
+    auto it = shard.slot_of_user.find(user_id);
+    if (it != shard.slot_of_user.end()) {
+        return shard.slots[it->second];
+    }
+
+    // CLOCK: avança o ponteiro dando uma "segunda chance" a slots referenciados recentemente.
+    size_t victim;
+    for (;;) {
+        Slot& candidate = shard.slots[shard.clock_hand];
+        victim = shard.clock_hand;
+        shard.clock_hand = (shard.clock_hand + 1) % shard.capacity;
+        if (candidate.user_id == -1) break;
+        if (!candidate.referenced.exchange(false, std::memory_order_relaxed)) break;
+    }
+
+    Slot& slot = shard.slots[victim];
+    if (slot.user_id != -1) {
+        shard.slot_of_user.erase(slot.user_id);
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot.user_id = user_id;
+    slot.has_neighbors = false;
+    slot.has_recommendations = false;
+    slot.stored_top_n = 0;
+    slot.neighbor_stats = NeighborSimilarityStats();
+    slot.neighbors.clear();
+    slot.recommendations.clear();
+    slot.referenced.store(true, std::memory_order_relaxed);
+    shard.slot_of_user[user_id] = victim;
+    return slot;
+}
+
+bool RecommendationCache::lookupNeighbors(int user_id, NeighborList& out_neighbors) const {
+    Shard& shard = shardFor(user_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.slot_of_user.find(user_id);
+    if (it != shard.slot_of_user.end()) {
+        const Slot& slot = shard.slots[it->second];
+        if (slot.has_neighbors) {
+            slot.referenced.store(true, std::memory_order_relaxed);
+            out_neighbors = slot.neighbors;
+            neighbor_hits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    neighbor_misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool RecommendationCache::lookupRecommendations(int user_id, int top_n,
+                                                RecommendationList& out_recommendations,
+                                                NeighborSimilarityStats& out_neighbor_stats) const {
+    Shard& shard = shardFor(user_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.slot_of_user.find(user_id);
+    if (it != shard.slot_of_user.end()) {
+        const Slot& slot = shard.slots[it->second];
+        // Uma lista gravada com menos itens que o top_n gravado já é a lista completa.
+        bool covers_request = slot.stored_top_n >= top_n ||
+                              static_cast<int>(slot.recommendations.size()) < slot.stored_top_n;
+        if (slot.has_recommendations && covers_request) {
+            slot.referenced.store(true, std::memory_order_relaxed);
+            size_t count = std::min(slot.recommendations.size(), static_cast<size_t>(std::max(top_n, 0)));
+            out_recommendations.assign(slot.recommendations.begin(), slot.recommendations.begin() + count);
+            out_neighbor_stats = slot.neighbor_stats;
+            recommendation_hits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    recommendation_misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void RecommendationCache::storeNeighbors(int user_id, const NeighborList& neighbors) {
+    Shard& shard = shardFor(user_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    Slot& slot = acquireSlot(shard, user_id);
+    slot.neighbors = neighbors;
+    slot.has_neighbors = true;
+}
+
+void RecommendationCache::storeRecommendations(int user_id, int top_n,
+                                               const RecommendationList& recommendations,
+                                               const NeighborSimilarityStats& neighbor_stats) {
+    Shard& shard = shardFor(user_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    Slot& slot = acquireSlot(shard, user_id);
+    size_t count = std::min(recommendations.size(), static_cast<size_t>(std::max(top_n, 0)));
+    slot.recommendations.assign(recommendations.begin(), recommendations.begin() + count);
+    slot.stored_top_n = top_n;
+    slot.neighbor_stats = neighbor_stats;
+    slot.has_recommendations = true;
+}
+
+void RecommendationCache::invalidateUser(int user_id) {
+    Shard& shard = shardFor(user_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.slot_of_user.find(user_id);
+    if (it == shard.slot_of_user.end()) return;
+
+    Slot& slot = shard.slots[it->second];
+    slot.user_id = -1;
+    slot.has_neighbors = false;
+    slot.has_recommendations = false;
+    slot.neighbors.clear();
+    slot.recommendations.clear();
+    slot.referenced.store(false, std::memory_order_relaxed);
+    shard.slot_of_user.erase(it);
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecommendationCache::invalidateAll() {
+    for (size_t s = 0; s < num_shards_; ++s) {
+        Shard& shard = shards_[s];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (size_t i = 0; i < shard.capacity; ++i) {
+            Slot& slot = shard.slots[i];
+            slot.user_id = -1;
+            slot.has_neighbors = false;
+            slot.has_recommendations = false;
+            slot.neighbors.clear();
+            slot.recommendations.clear();
+            slot.referenced.store(false, std::memory_order_relaxed);
+        }
+        invalidations_.fetch_add(shard.slot_of_user.size(), std::memory_order_relaxed);
+        shard.slot_of_user.clear();
+        shard.clock_hand = 0;
+    }
+}
+
+RecommendationCacheStats RecommendationCache::stats() const {
+    RecommendationCacheStats result;
+    result.neighbor_hits = neighbor_hits_.load(std::memory_order_relaxed);
+    result.neighbor_misses = neighbor_misses_.load(std::memory_order_relaxed);
+    result.recommendation_hits = recommendation_hits_.load(std::memory_order_relaxed);
+    result.recommendation_misses = recommendation_misses_.load(std::memory_order_relaxed);
+    result.evictions = evictions_.load(std::memory_order_relaxed);
+    result.invalidations = invalidations_.load(std::memory_order_relaxed);
+    return result;
+}
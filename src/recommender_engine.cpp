@@ -1,78 +1,211 @@
 #include "../include/recommender_engine.hpp"
 #include "../include/config.hpp" // Para NUM_HYPERPLANES_PER_TABLE
+#include "../include/recommendation_cache.hpp"
+#include "../include/output_writer.hpp"
+#include "../include/binary_output.hpp"
+#include "../include/compressed_rows.hpp"
+#include "../include/sparse_dot.hpp"
+#include "../include/similarity_policies.hpp"
+#include "../include/simhash.hpp"
+#include "../include/knn_graph.hpp"
 #include <cmath>
 #include <algorithm>
 #include <vector>
 #include <iostream>
-#include <set> // Para coletar candidatos únicos
 #include <fstream>
-#include <sstream>
-#include <iomanip>
+#include <atomic>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
-// convertToUserItemMatrix e computeUserNorms permanecem como na versão OpenMP anterior
-UserItemMatrix convertToUserItemMatrix(const UserRatingsLog& users_ratings_log) {
-    UserItemMatrix user_item_matrix;
+// As tabelas LSH têm 2^k buckets indexados diretamente pelo hash.
+constexpr int MAX_HYPERPLANES_PER_DENSE_TABLE = 24;
+static_assert(NUM_HYPERPLANES_PER_TABLE <= MAX_HYPERPLANES_PER_DENSE_TABLE,
+              "NUM_HYPERPLANES_PER_TABLE grande demais para tabelas LSH com buckets densos");
+
+namespace {
+
+// Chama `kernel(ratings, scale)` com o array de notas da representação ativa; nota = ratings[p] * scale.
+// Como as notas são múltiplos exatos de 0.5, os dois caminhos produzem os mesmos floats.
+template <typename Kernel>
+inline void withRatings(const RatingMatrix& matrix, Kernel&& kernel) {
+    if (matrix.isQuantized()) {
+        kernel(matrix.row_rating_units.data(), RATING_UNIT);
+    } else {
+        kernel(matrix.row_ratings.data(), 1.0f);
+    }
+}
+
+} // namespace
+
+DenseIdMap buildDenseIdMap(const std::vector<int>& external_ids) {
+    DenseIdMap id_map;
+    id_map.dense_to_external.reserve(external_ids.size());
+    int max_id = -1;
+    for (int id : external_ids) max_id = std::max(max_id, id);
+    id_map.external_to_dense.assign(static_cast<size_t>(max_id + 1), -1);
+    for (int id : external_ids) {
+        if (id < 0 || id_map.external_to_dense[id] != -1) continue; // Ignora IDs inválidos e repetidos
+        id_map.external_to_dense[id] = id_map.size();
+        id_map.dense_to_external.push_back(id);
+    }
+    return id_map;
+}
+
+RatingMatrix buildRatingMatrix(const UserRatingsLog& users_ratings_log,
+                               const std::unordered_set<int>& valid_movie_ids,
+                               bool quantize_ratings,
+                               bool compress_rows) {
+    RatingMatrix matrix;
+
+    // Usuários e filmes recebem índices em ordem crescente de ID: comparar índices equivale a
+    // comparar IDs, e o índice (que também escolhe a componente dos hiperplanos de cada filme)
+    // não depende da ordem de iteração dos conjuntos montados em paralelo na ingestão.
+    std::vector<int> movie_ids(valid_movie_ids.begin(), valid_movie_ids.end());
+    std::sort(movie_ids.begin(), movie_ids.end());
+    matrix.movies = buildDenseIdMap(movie_ids);
+
+    std::vector<const UserRatingsLog::value_type*> user_entries;
+    user_entries.reserve(users_ratings_log.size());
     for (const auto& user_entry : users_ratings_log) {
-        for (const auto& movie_rating_pair : user_entry.second) {
-            user_item_matrix[user_entry.first][movie_rating_pair.first] = movie_rating_pair.second;
+        if (!user_entry.second.empty()) user_entries.push_back(&user_entry);
+    }
+    std::sort(user_entries.begin(), user_entries.end(),
+              [](const auto* a, const auto* b) { return a->first < b->first; });
+    std::vector<int> user_ids(user_entries.size());
+    for (size_t u = 0; u < user_entries.size(); ++u) user_ids[u] = user_entries[u]->first;
+    matrix.users = buildDenseIdMap(user_ids);
+
+    // Converte cada linha para índices densos ordenados. Avaliações repetidas do mesmo filme
+    // mantêm a última, como na matriz baseada em mapas.
+    // As linhas são convertidas em uma única área de trabalho (o tamanho bruto de cada linha é um
+    // limite superior), em vez de um vetor alocado por usuário.
+    const int U = matrix.numUsers();
+    std::vector<size_t> staging_offsets(U + 1, 0);
+    for (int u = 0; u < U; ++u) staging_offsets[u + 1] = staging_offsets[u] + user_entries[u]->second.size();
+    std::vector<std::pair<int, float>> staging(staging_offsets[U]);
+    std::vector<uint32_t> row_sizes(U);
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < U; ++u) {
+        std::pair<int, float>* row = staging.data() + staging_offsets[u];
+        size_t size = 0;
+        for (const auto& [movie_id, rating] : user_entries[u]->second) {
+            int movie_idx = matrix.movies.toDense(movie_id);
+            if (movie_idx >= 0) row[size++] = {movie_idx, rating};
         }
+        std::stable_sort(row, row + size,
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        size_t out = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (out > 0 && row[out - 1].first == row[i].first) {
+                row[out - 1].second = row[i].second;
+            } else {
+                row[out++] = row[i];
+            }
+        }
+        row_sizes[u] = static_cast<uint32_t>(out);
     }
-    return user_item_matrix;
-}
 
-UserNormsMap computeUserNorms(const UserItemMatrix& user_item_matrix) {
-    UserNormsMap norms_map;
-    norms_map.reserve(user_item_matrix.size());
+    matrix.row_offsets.assign(U + 1, 0);
+    for (int u = 0; u < U; ++u) {
+        matrix.row_offsets[u + 1] = matrix.row_offsets[u] + row_sizes[u];
+    }
+    // A quantização só é usada se toda nota for um múltiplo exato de meia estrela que caiba em uint8_t.
+    bool quantizable = quantize_ratings;
+    if (quantizable) {
+        #pragma omp parallel for schedule(dynamic, 64) reduction(&&:quantizable)
+        for (int u = 0; u < U; ++u) {
+            const std::pair<int, float>* row = staging.data() + staging_offsets[u];
+            for (uint32_t i = 0; i < row_sizes[u]; ++i) {
+                float units = row[i].second / RATING_UNIT;
+                quantizable = quantizable && units >= 0.0f && units <= 255.0f && units == std::round(units);
+            }
+        }
+        if (!quantizable) {
+            std::cerr << "Aviso: há notas que não são múltiplos de " << RATING_UNIT
+                      << "; a matriz de avaliações será mantida em float." << std::endl;
+        }
+    }
 
-    std::vector<int> user_ids;
-    user_ids.reserve(user_item_matrix.size());
-    for (const auto& pair : user_item_matrix) {
-        user_ids.push_back(pair.first);
+    const uint32_t num_ratings = matrix.row_offsets[U];
+    matrix.row_movies.resize(num_ratings);
+    if (quantizable) {
+        matrix.row_rating_units.resize(num_ratings);
+    } else {
+        matrix.row_ratings.resize(num_ratings);
     }
 
-    std::vector<float> norms(user_ids.size());
-    
-    #pragma omp parallel for schedule(dynamic)
-    for (size_t i = 0; i < user_ids.size(); ++i) {
-        const auto& ratings = user_item_matrix.at(user_ids[i]);
-        float sum = 0.0f;
-        for (const auto& r : ratings) sum += r.second * r.second;
-        norms[i] = std::sqrt(sum);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < U; ++u) {
+        uint32_t pos = matrix.row_offsets[u];
+        const std::pair<int, float>* row = staging.data() + staging_offsets[u];
+        for (uint32_t i = 0; i < row_sizes[u]; ++i) {
+            const auto& [movie_idx, rating] = row[i];
+            matrix.row_movies[pos] = movie_idx;
+            if (quantizable) {
+                matrix.row_rating_units[pos] = static_cast<uint8_t>(std::lround(rating / RATING_UNIT));
+            } else {
+                matrix.row_ratings[pos] = rating;
+            }
+            ++pos;
+        }
     }
+    if (compress_rows) compressRatingRows(matrix);
+    return matrix;
+}
 
-    for (size_t i = 0; i < user_ids.size(); ++i) {
-        norms_map[user_ids[i]] = norms[i];
+void attachMovieGenres(RatingMatrix& matrix, const MovieCatalog& movie_catalog) {
+    const int D = matrix.numMovies();
+    matrix.movie_genres.assign(D, 0);
+    for (int movie_idx = 0; movie_idx < D; ++movie_idx) {
+        matrix.movie_genres[movie_idx] = movie_catalog.genresOf(matrix.movies.toExternal(movie_idx));
     }
-    return norms_map;
 }
 
-float calculateCosineSimilarity(const std::unordered_map<int, float>& ratings_user_a,
-                                const std::unordered_map<int, float>& ratings_user_b,
+UserNormsVec computeUserNorms(const RatingMatrix& matrix) {
+    const int U = matrix.numUsers();
+    UserNormsVec norms(U);
+
+    if (matrix.isQuantized()) {
+        // Soma de quadrados inteira; o laço é vetorizado com alargamento uint8_t -> uint32_t.
+        const uint8_t* units = matrix.row_rating_units.data();
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int u = 0; u < U; ++u) {
+            uint32_t sum = 0;
+            const uint32_t row_begin = matrix.rowBegin(u), row_end = matrix.rowEnd(u);
+            #pragma omp simd reduction(+:sum)
+            for (uint32_t p = row_begin; p < row_end; ++p) {
+                sum += static_cast<uint32_t>(units[p]) * units[p];
+            }
+            norms[u] = RATING_UNIT * std::sqrt(static_cast<float>(sum));
+        }
+        return norms;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < U; ++u) {
+        float sum = 0.0f;
+        for (uint32_t p = matrix.rowBegin(u); p < matrix.rowEnd(u); ++p) {
+            sum += matrix.row_ratings[p] * matrix.row_ratings[p];
+        }
+        norms[u] = std::sqrt(sum);
+    }
+    return norms;
+}
+
+float calculateCosineSimilarity(const RatingMatrix& matrix,
+                                int user_a,
+                                int user_b,
                                 float norm_user_a,
                                 float norm_user_b) {
     if (norm_user_a == 0.0f || norm_user_b == 0.0f) {
         return 0.0f;
     }
-    float dot_product = 0.0f;
-    if (ratings_user_a.size() < ratings_user_b.size()) {
-        for (const auto& rating_entry_a : ratings_user_a) {
-            auto it_b = ratings_user_b.find(rating_entry_a.first);
-            if (it_b != ratings_user_b.end()) {
-                dot_product += rating_entry_a.second * it_b->second;
-            }   
-        }
-    } else {
-        for (const auto& rating_entry_b : ratings_user_b) {
-            auto it_a = ratings_user_a.find(rating_entry_b.first);
-            if (it_a != ratings_user_a.end()) {
-                dot_product += it_a->second * rating_entry_b.second;
-            }
-        }
-    }
+    // Interseção das duas linhas (ambas ordenadas por índice denso do filme); o kernel é
+    // escolhido pela razão entre os tamanhos e pelos recursos da CPU.
+    const float dot_product = sparseRowDot(matrix, user_a, user_b);
     if (dot_product == 0.0f) return 0.0f;
     return dot_product / (norm_user_a * norm_user_b);
 }
@@ -94,9 +227,9 @@ HyperplaneSet generateSingleHyperplaneSet(int num_hyperplanes, int dimensionalit
     return hyperplane_set;
 }
 
-LSHHashValue computeLSHHash(const std::unordered_map<int, float>& user_ratings,
-                            const HyperplaneSet& hyperplane_set,
-                            const MovieIdToDenseIdxMap& movie_to_idx) {
+LSHHashValue computeLSHHash(const RatingMatrix& matrix,
+                            int user_idx,
+                            const HyperplaneSet& hyperplane_set) {
     LSHHashValue hash = 0;
     if (hyperplane_set.empty()) return hash; // Nenhum hiperplano, hash 0
 
@@ -107,144 +240,206 @@ LSHHashValue computeLSHHash(const std::unordered_map<int, float>& user_ratings,
         // Por agora, vamos prosseguir, mas isso é uma verificação importante.
     }
 
-    for (size_t i = 0; i < hyperplane_set.size(); ++i) {
-        const auto& plane = hyperplane_set[i];
-        float dot_product = 0.0f;
-        for (const auto& rating_entry : user_ratings) {
-            int movie_id = rating_entry.first;
-            float rating = rating_entry.second;
-            auto it_idx = movie_to_idx.find(movie_id);
-            if (it_idx != movie_to_idx.end()) {
-                int dense_idx = it_idx->second;
-                if (dense_idx < static_cast<int>(plane.size())) {
-                    dot_product += rating * plane[dense_idx];
+    withRatings(matrix, [&](const auto* ratings, float scale) {
+        for (size_t i = 0; i < hyperplane_set.size(); ++i) {
+            const auto& plane = hyperplane_set[i];
+            float dot_product = 0.0f;
+            forEachRowEntry(matrix, user_idx, [&](uint32_t p, int movie_idx) {
+                if (movie_idx < static_cast<int>(plane.size())) {
+                    dot_product += (ratings[p] * scale) * plane[movie_idx];
                 }
+            });
+            if (dot_product >= 0) {
+                hash |= (1ULL << i);
             }
         }
-        if (dot_product >= 0) {
-            hash |= (1ULL << i);
-        }
-    }
+    });
     return hash;
 }
 
-void buildLSHTables(const UserItemMatrix& user_item_matrix,
+void buildLSHTables(const RatingMatrix& matrix,
                     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-                    const MovieIdToDenseIdxMap& movie_to_idx,
-                    std::vector<LSHBucketMap>& lsh_tables) {
+                    std::vector<LSHTable>& lsh_tables) {
     if (all_hyperplane_sets.empty()) return;
 
-    lsh_tables.assign(all_hyperplane_sets.size(), LSHBucketMap());
+    lsh_tables.assign(all_hyperplane_sets.size(), LSHTable());
+    const int U = matrix.numUsers();
+    std::vector<LSHHashValue> user_hashes(U);
 
-    // Converte user_item_matrix para um vetor para paralelização mais fácil
-    std::vector<std::pair<int, const std::unordered_map<int, float>*>> user_matrix_vec;
-    user_matrix_vec.reserve(user_item_matrix.size());
-    for(const auto& entry : user_item_matrix) {
-        user_matrix_vec.push_back({entry.first, &entry.second});
-    }
-
-    // Paraleliza a construção de cada tabela LSH individualmente,
-    // ou paraleliza o loop sobre os usuários para todas as tabelas.
-    // Paralelizar o loop sobre usuários parece mais direto aqui.
-    // Cada thread precisará de acesso de escrita sincronizado a lsh_tables.
-    // Alternativamente, cada thread preenche suas próprias tabelas LSH e depois mescla.
-    // Para simplificar, vamos paralelizar a iteração do usuário e usar locks para inserções de bucket.
-    // No entanto, isso pode levar a contenção.
-    // Um padrão melhor: cada thread calcula hashes e os armazena temporariamente com user_id,
-    // depois, uma fase sequencial ou mais cuidadosamente paralelizada preenche os buckets.
-
-    // Vamos tentar uma abordagem onde cada thread calcula hashes para um subconjunto de usuários
-    // e os adiciona às tabelas LSH (que precisam ser thread-safe ou preenchidas sequencialmente depois).
-
-    // Para este exemplo, vamos iterar sobre as tabelas LSH sequencialmente
-    // e paralelizar a inserção de usuários em cada tabela.
     for (size_t table_idx = 0; table_idx < all_hyperplane_sets.size(); ++table_idx) {
         const auto& current_hyperplane_set = all_hyperplane_sets[table_idx];
-        LSHBucketMap& current_bucket_map = lsh_tables[table_idx];
-
-        int n_threads = 1;
-        #ifdef _OPENMP
-        n_threads = omp_get_max_threads();
-        #endif
-        std::vector<std::vector<std::pair<LSHHashValue, int>>> thread_local_hashes(n_threads);
-
-        #pragma omp parallel for schedule(dynamic)
-        for (size_t i = 0; i < user_matrix_vec.size(); ++i) {
-            int user_id = user_matrix_vec[i].first;
-            const auto& user_ratings = *(user_matrix_vec[i].second);
-            LSHHashValue hash = computeLSHHash(user_ratings, current_hyperplane_set, movie_to_idx);
-            
-            int thread_id = 0;
-            #ifdef _OPENMP
-            thread_id = omp_get_thread_num();
-            #endif
-            thread_local_hashes[thread_id].emplace_back(hash, user_id);
+        if (current_hyperplane_set.size() > static_cast<size_t>(MAX_HYPERPLANES_PER_DENSE_TABLE)) {
+            std::cerr << "Erro: tabelas LSH densas suportam no máximo " << MAX_HYPERPLANES_PER_DENSE_TABLE
+                      << " hiperplanos por tabela." << std::endl;
+            lsh_tables.clear();
+            return;
         }
+        LSHTable& table = lsh_tables[table_idx];
+        const size_t num_buckets = size_t(1) << current_hyperplane_set.size();
 
-        // Fase sequencial para preencher o bucket_map a partir dos resultados das threads
-        for (const auto& local_hashes : thread_local_hashes) {
-            for (const auto& hash_user_pair : local_hashes) {
-                current_bucket_map[hash_user_pair.first].push_back(hash_user_pair.second);
-            }
+        // Cada usuário escreve o próprio hash: não há dados locais por thread nem fase de mescla.
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int u = 0; u < U; ++u) {
+            user_hashes[u] = computeLSHHash(matrix, u, current_hyperplane_set);
         }
+
+        // Counting sort por bucket; dentro de um bucket os usuários ficam em ordem crescente.
+        table.bucket_offsets.assign(num_buckets + 1, 0);
+        for (int u = 0; u < U; ++u) table.bucket_offsets[user_hashes[u] + 1]++;
+        for (size_t h = 0; h < num_buckets; ++h) table.bucket_offsets[h + 1] += table.bucket_offsets[h];
+        table.bucket_users.resize(U);
+        std::vector<uint32_t> fill_pos(table.bucket_offsets.begin(), table.bucket_offsets.end() - 1);
+        for (int u = 0; u < U; ++u) table.bucket_users[fill_pos[user_hashes[u]]++] = u;
+        table.user_buckets.assign(user_hashes.begin(), user_hashes.end());
     }
 }
 
 
 NeighborList findApproximateKNearestNeighborsLSH(
-    int target_user_id,
-    const UserItemMatrix& user_item_matrix,
-    const UserNormsMap& user_norms,
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
-    int K) {
+    const std::vector<LSHTable>& lsh_tables,
+    int K,
+    const SimHashSignatures* signatures,
+    int min_collisions,
+    size_t max_exact_candidates,
+    QueryBudget* budget) {
+    NeighborList neighbors;
+    findApproximateKNearestNeighborsLSH(target_user_idx, matrix, user_norms, all_hyperplane_sets, lsh_tables, K,
+                                        neighbors, signatures, min_collisions, max_exact_candidates, budget);
+    return neighbors;
+}
 
-    auto it_target_user_ratings = user_item_matrix.find(target_user_id);
-    if (it_target_user_ratings == user_item_matrix.end()) {
-        std::cerr << "Warning: Target user " << target_user_id << " not found for LSH KNN." << std::endl;
-        return {};
+void findApproximateKNearestNeighborsLSH(
+    int target_user_idx,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
+    const std::vector<HyperplaneSet>& all_hyperplane_sets,
+    const std::vector<LSHTable>& lsh_tables,
+    int K,
+    NeighborList& potential_neighbors,
+    const SimHashSignatures* signatures,
+    int min_collisions,
+    size_t max_exact_candidates,
+    QueryBudget* budget) {
+
+    potential_neighbors.clear();
+    const int U = matrix.numUsers();
+    if (target_user_idx < 0 || target_user_idx >= U) {
+        std::cerr << "Warning: Target user index " << target_user_idx << " out of range for LSH KNN." << std::endl;
+        return;
     }
-    const auto& target_ratings = it_target_user_ratings->second; // O campo .second desse iterador contém o mapa de avaliações desse usuário, onde cada chave é o ID de um filme e o valor é a nota dada.
-    float target_norm = user_norms.at(target_user_id);
-
-    std::set<int> candidate_user_ids; // Usar std::set para obter candidatos únicos automaticamente
 
+    // Contador denso de colisões por usuário: o primeiro encontro registra o candidato e os
+    // seguintes apenas incrementam. Só as posições tocadas são zeradas ao final da consulta.
+    thread_local std::vector<uint16_t> collision_count;
+    if (static_cast<int>(collision_count.size()) != U) collision_count.assign(U, 0);
+
+    // Buffers de trabalho por thread, reaproveitados entre consultas (sem alocação em regime).
+    // A região paralela abaixo acessa os do thread chamador pelas referências locais.
+    thread_local std::vector<int> candidate_storage;
+    thread_local std::vector<std::pair<uint32_t, int>> scored_storage;
+    thread_local std::vector<std::pair<int, float>> local_neighbors_storage;
+    std::vector<int>& candidate_vec = candidate_storage;
+    candidate_vec.clear();
     for (size_t table_idx = 0; table_idx < lsh_tables.size(); ++table_idx) {
-        LSHHashValue target_hash = computeLSHHash(target_ratings, all_hyperplane_sets[table_idx], movie_to_idx);
-        
-        const auto& current_bucket_map = lsh_tables[table_idx];
-        auto bucket_it = current_bucket_map.find(target_hash);
-        if (bucket_it != current_bucket_map.end()) {
-            for (int candidate_id : bucket_it->second) {
-                if (candidate_id != target_user_id) {
-                    candidate_user_ids.insert(candidate_id);
-                }
-            }
-        }
+        const LSHTable& table = lsh_tables[table_idx];
+        LSHHashValue target_hash = static_cast<size_t>(target_user_idx) < table.user_buckets.size()
+            ? table.user_buckets[target_user_idx]
+            : computeLSHHash(matrix, target_user_idx, all_hyperplane_sets[table_idx]);
+        // Listas comprimidas são decodificadas e deduplicadas no mesmo passo, 4 membros por vez.
+        forEachBucketUser(table, target_hash, [&](int candidate_idx) {
+            if (candidate_idx == target_user_idx) return;
+            if (collision_count[candidate_idx]++ == 0) candidate_vec.push_back(candidate_idx);
+        });
         // Opcional: Multi-probe LSH - verifica buckets vizinhos (hashes com pequena distância de Hamming)
     }
 
-    NeighborList potential_neighbors;
-    std::vector<int> candidate_vec(candidate_user_ids.begin(), candidate_user_ids.end());
-    std::vector<std::pair<int, float>> local_neighbors(candidate_vec.size());
+    // Pré-seleção: descarta quem colidiu em poucas tabelas e, se houver limite, mantém os que mais
+    // colidiram (empates pelo menor índice). O cosseno exato só roda sobre os que sobram.
+    // partition/nth_element apenas permutam o vetor, então todas as posições tocadas continuam nele.
+    size_t num_selected = std::partition(candidate_vec.begin(), candidate_vec.end(), [&](int candidate_idx) {
+        return collision_count[candidate_idx] >= min_collisions;
+    }) - candidate_vec.begin();
+    auto more_collisions = [&](int a, int b) {
+        if (collision_count[a] != collision_count[b]) return collision_count[a] > collision_count[b];
+        return a < b;
+    };
+    if (max_exact_candidates > 0 && num_selected > max_exact_candidates) {
+        std::nth_element(candidate_vec.begin(), candidate_vec.begin() + max_exact_candidates,
+                         candidate_vec.begin() + num_selected, more_collisions);
+        num_selected = max_exact_candidates;
+    }
+    // Com orçamento, os candidatos são avaliados em ordem de prioridade (mais colisões primeiro),
+    // para que um corte por prazo descarte os menos promissores.
+    const bool prioritize = budget != nullptr && budget->isLimited();
+    if (prioritize) std::sort(candidate_vec.begin(), candidate_vec.begin() + num_selected, more_collisions);
+    for (int candidate_idx : candidate_vec) collision_count[candidate_idx] = 0;
+    candidate_vec.resize(num_selected);
+
+    // Pré-filtro SimHash: XOR + popcount sobre as assinaturas (contíguas, cabem em cache) corta
+    // a lista antes de qualquer acesso às linhas de avaliações.
+    if (SIMHASH_PREFILTER_ENABLED && signatures != nullptr && !signatures->empty()) {
+        const int num_bits = signatures->numBits();
+        const uint32_t max_distance = simHashMaxDistanceForSimilarity(SIMHASH_PREFILTER_MIN_SIMILARITY, num_bits);
+        const uint64_t* target_signature = signatures->of(target_user_idx);
+        std::vector<std::pair<uint32_t, int>>& scored = scored_storage;
+        scored.clear();
+        for (int candidate_idx : candidate_vec) {
+            uint32_t distance = simHashHammingDistance(target_signature, signatures->of(candidate_idx), signatures->num_words);
+            if (distance <= max_distance) scored.emplace_back(distance, candidate_idx);
+        }
+        if (SIMHASH_PREFILTER_MAX_CANDIDATES > 0 && scored.size() > SIMHASH_PREFILTER_MAX_CANDIDATES) {
+            // Menor distância primeiro; empates pelo menor índice.
+            std::nth_element(scored.begin(), scored.begin() + SIMHASH_PREFILTER_MAX_CANDIDATES, scored.end());
+            scored.resize(SIMHASH_PREFILTER_MAX_CANDIDATES);
+        }
+        // Com orçamento a prioridade passa a ser a similaridade estimada (menor distância primeiro).
+        if (prioritize) std::sort(scored.begin(), scored.end());
+        candidate_vec.clear();
+        for (const auto& entry : scored) candidate_vec.push_back(entry.second);
+    }
+    if (!prioritize) std::sort(candidate_vec.begin(), candidate_vec.end());
+    if (prioritize && budget->max_candidate_evaluations > 0 &&
+        candidate_vec.size() > budget->max_candidate_evaluations) {
+        candidate_vec.resize(budget->max_candidate_evaluations);
+        budget->degraded = true;
+    }
+
+    std::vector<std::pair<int, float>>& local_neighbors = local_neighbors_storage;
+    local_neighbors.resize(candidate_vec.size());
+
+    // A linha do alvo é decodificada e espalhada em um vetor denso uma única vez; cada candidato
+    // custa então um acesso direto por avaliação. As threads da região abaixo só leem o contexto.
+    thread_local QueryRowContext target_row_storage;
+    target_row_storage.load(matrix, target_user_idx, true);
+    const QueryRowContext* target_row = &target_row_storage;
+
+    // Prazo: cada thread consulta o relógio a cada 32 candidatos; ao estourar, os candidatos
+    // restantes (os de menor prioridade) são pulados.
+    const bool check_deadline = prioritize && budget->hasDeadline();
+    std::atomic<bool> out_of_time{false};
 
 #pragma omp parallel for schedule(dynamic)
     for (size_t i = 0; i < candidate_vec.size(); ++i) {
-        int candidate_id = candidate_vec[i];
-        auto it_candidate_ratings = user_item_matrix.find(candidate_id);
-        if (it_candidate_ratings != user_item_matrix.end()) {
-            float candidate_norm = user_norms.at(candidate_id);
-            float similarity = calculateCosineSimilarity(target_ratings, it_candidate_ratings->second, target_norm, candidate_norm);
-            if (similarity > 0.0f) {
-                local_neighbors[i] = std::make_pair(candidate_id, similarity);
-            } else {
-                local_neighbors[i] = std::make_pair(-1, 0.0f);
+        local_neighbors[i] = std::make_pair(-1, 0.0f);
+        if (check_deadline) {
+            if (out_of_time.load(std::memory_order_relaxed)) continue;
+            if ((i & 31) == 0 && budget->expired()) {
+                out_of_time.store(true, std::memory_order_relaxed);
+                continue;
             }
-        } else {
-            local_neighbors[i] = std::make_pair(-1, 0.0f);
+        }
+        int candidate_idx = candidate_vec[i];
+        // Kernel da métrica configurada, resolvido em tempo de compilação.
+        const float similarity = targetSimilarity<ConfiguredSimilarity>(matrix, user_norms, *target_row, candidate_idx);
+        if (similarity > 0.0f) {
+            local_neighbors[i] = std::make_pair(candidate_idx, similarity);
         }
     }
+    if (out_of_time.load()) budget->degraded = true;
     for (const auto& p : local_neighbors) {
         if (p.first != -1) {
             potential_neighbors.push_back(p);
@@ -257,114 +452,149 @@ NeighborList findApproximateKNearestNeighborsLSH(
     if (potential_neighbors.size() > static_cast<size_t>(K)) {
         potential_neighbors.resize(K);
     }
-    return potential_neighbors;
 }
 
 RecommendationList generateRecommendationsLSH(
-    int target_user_id,
+    int target_user_idx,
     int K_neighbors_for_recs,
-    const UserItemMatrix& all_user_ratings,
-    const UserNormsMap& user_norms,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
+    const std::vector<LSHTable>& lsh_tables,
     const NeighborList* precomputed_neighbors,
     float similarity_threshold,
-    bool use_user_mean_filter
+    bool use_user_mean_filter,
+    const GenreFilter& genre_filter,
+    const SimHashSignatures* signatures,
+    QueryBudget* budget
 ) {
-    NeighborList k_approx_neighbors;
-    if (precomputed_neighbors) {
-        k_approx_neighbors = *precomputed_neighbors;
-    } else {
-        k_approx_neighbors = findApproximateKNearestNeighborsLSH(
-            target_user_id, all_user_ratings, user_norms, 
-            all_hyperplane_sets, lsh_tables, movie_to_idx, K_neighbors_for_recs);
+    RecommendationList recommendations;
+    generateRecommendationsLSH(target_user_idx, K_neighbors_for_recs, matrix, user_norms, all_hyperplane_sets,
+                               lsh_tables, recommendations, precomputed_neighbors, similarity_threshold,
+                               use_user_mean_filter, genre_filter, signatures, budget);
+    return recommendations;
+}
+
+void generateRecommendationsLSH(
+    int target_user_idx,
+    int K_neighbors_for_recs,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
+    const std::vector<HyperplaneSet>& all_hyperplane_sets,
+    const std::vector<LSHTable>& lsh_tables,
+    RecommendationList& recommendations,
+    const NeighborList* precomputed_neighbors,
+    float similarity_threshold,
+    bool use_user_mean_filter,
+    const GenreFilter& genre_filter,
+    const SimHashSignatures* signatures,
+    QueryBudget* budget
+) {
+    recommendations.clear();
+    if (target_user_idx < 0 || target_user_idx >= matrix.numUsers()) {
+        return; // Usuário alvo não encontrado
     }
+    const NeighborList* neighbors = precomputed_neighbors;
+    thread_local NeighborList computed_neighbors;
+    if (!neighbors) {
+        findApproximateKNearestNeighborsLSH(
+            target_user_idx, matrix, user_norms,
+            all_hyperplane_sets, lsh_tables, K_neighbors_for_recs, computed_neighbors, signatures,
+            LSH_MIN_CANDIDATE_COLLISIONS, LSH_MAX_EXACT_CANDIDATES, budget);
+        neighbors = &computed_neighbors;
+    }
+    const NeighborList& k_approx_neighbors = *neighbors;
     if (k_approx_neighbors.empty()) {
-        return {};
+        return;
     }
 
-    auto it_target_ratings_map = all_user_ratings.find(target_user_id);
-    if (it_target_ratings_map == all_user_ratings.end()) {
-        return {}; // Usuário alvo não encontrado
+    // Acumuladores densos por thread, reutilizados entre consultas. movie_state marca os filmes
+    // já vistos pelo alvo (1) e os que já receberam alguma contribuição (2).
+    const int D = matrix.numMovies();
+    thread_local std::vector<float> weighted_score_sum;
+    thread_local std::vector<float> similarity_sum;
+    thread_local std::vector<char> movie_state;
+    thread_local std::vector<int> touched;
+    if (static_cast<int>(weighted_score_sum.size()) != D) {
+        weighted_score_sum.assign(D, 0.0f);
+        similarity_sum.assign(D, 0.0f);
+        movie_state.assign(D, 0);
     }
-    const auto& target_user_seen_movies = it_target_ratings_map->second;
+    touched.clear();
 
     // Calcular média do usuário alvo
     float user_mean = 0.0f;
-    if (!target_user_seen_movies.empty()) {
-        float sum = 0.0f;
-        for (const auto& p : target_user_seen_movies) sum += p.second;
-        user_mean = sum / target_user_seen_movies.size();
-    }
-
-    int n_threads = 1;
-    #ifdef _OPENMP
-    n_threads = omp_get_max_threads();
-    #endif
-    std::vector<std::unordered_map<int, float>> movie_weighted_score_sum_local(n_threads);
-    std::vector<std::unordered_map<int, float>> movie_similarity_sum_local(n_threads);
-
-    #pragma omp parallel for schedule(dynamic)
-    for (size_t idx = 0; idx < k_approx_neighbors.size(); ++idx) {
-        int thread_id = 0;
-        #ifdef _OPENMP
-        thread_id = omp_get_thread_num();
-        #endif
-        int neighbor_id = k_approx_neighbors[idx].first;
-        float similarity_score = k_approx_neighbors[idx].second;
-        if (similarity_score < similarity_threshold) continue; // Ignorar vizinhos pouco similares
-        const auto& neighbor_ratings = all_user_ratings.at(neighbor_id);
-        for (const auto& movie_rating_entry : neighbor_ratings) {
-            int movie_id = movie_rating_entry.first;
-            float rating = movie_rating_entry.second;
-            if (target_user_seen_movies.count(movie_id)) {
-                continue;
+    forEachRowEntry(matrix, target_user_idx, [&](uint32_t p, int movie_idx) {
+        user_mean += matrix.ratingAt(p);
+        movie_state[movie_idx] = 1;
+    });
+    if (matrix.rowLength(target_user_idx) > 0) user_mean /= matrix.rowLength(target_user_idx);
+
+    // O filtro de gêneros é um teste de bits por filme dentro do laço de acumulação:
+    // filmes rejeitados nunca entram nos acumuladores nem na ordenação.
+    const bool filter_genres = genre_filter.isActive() && !matrix.movie_genres.empty();
+
+    withRatings(matrix, [&](const auto* ratings, float scale) {
+        for (const auto& [neighbor_idx, similarity_score] : k_approx_neighbors) {
+            if (similarity_score < similarity_threshold) continue; // Ignorar vizinhos pouco similares
+            // Vizinhos em ordem decrescente de similaridade: com o prazo esgotado, os que faltam são os menos úteis.
+            if (budget != nullptr && budget->expired()) {
+                budget->degraded = true;
+                break;
             }
-            movie_weighted_score_sum_local[thread_id][movie_id] += rating * similarity_score;
-            movie_similarity_sum_local[thread_id][movie_id] += similarity_score;
-        }
-    }
-    // Redução dos mapas locais para globais
-    std::unordered_map<int, float> movie_weighted_score_sum;
-    std::unordered_map<int, float> movie_similarity_sum;
-    for (int t = 0; t < n_threads; ++t) {
-        for (const auto& p : movie_weighted_score_sum_local[t]) {
-            movie_weighted_score_sum[p.first] += p.second;
-        }
-        for (const auto& p : movie_similarity_sum_local[t]) {
-            movie_similarity_sum[p.first] += p.second;
-        }
-    }
-    RecommendationList recommendations;
-    if (true) { // bloco principal
-        for (const auto& score_entry : movie_weighted_score_sum) {
-            int movie_id = score_entry.first;
-            float total_weighted_score = score_entry.second;
-            float total_similarity = movie_similarity_sum.at(movie_id);
-            if (total_similarity > 1.0f) {
-                float predicted_rating = total_weighted_score / total_similarity;
-                if (!use_user_mean_filter || predicted_rating > user_mean) {
-                    recommendations.emplace_back(movie_id, predicted_rating);
+            forEachRowEntry(matrix, neighbor_idx, [&](uint32_t p, int movie_idx) {
+                if (movie_state[movie_idx] == 1) return;
+                if (filter_genres && !genre_filter.accepts(matrix.movie_genres[movie_idx])) return;
+                if (movie_state[movie_idx] == 0) {
+                    movie_state[movie_idx] = 2;
+                    touched.push_back(movie_idx);
                 }
+                weighted_score_sum[movie_idx] += (ratings[p] * scale) * similarity_score;
+                similarity_sum[movie_idx] += similarity_score;
+            });
+        }
+    });
+
+    for (int movie_idx : touched) {
+        if (similarity_sum[movie_idx] > 1.0f) {
+            float predicted_rating = weighted_score_sum[movie_idx] / similarity_sum[movie_idx];
+            if (!use_user_mean_filter || predicted_rating > user_mean) {
+                recommendations.emplace_back(movie_idx, predicted_rating);
             }
         }
-        if (recommendations.empty()) {
-            // Fallback: recomenda todos com total_similarity > 0
-            for (const auto& score_entry : movie_weighted_score_sum) {
-                int movie_id = score_entry.first;
-                float total_weighted_score = score_entry.second;
-                float total_similarity = movie_similarity_sum.at(movie_id);
-                if (total_similarity > 0.0f) {
-                    float predicted_rating = total_weighted_score / total_similarity;
-                    recommendations.emplace_back(movie_id, predicted_rating);
-                }
+    }
+    if (recommendations.empty()) {
+        // Fallback: recomenda todos com total_similarity > 0
+        for (int movie_idx : touched) {
+            if (similarity_sum[movie_idx] > 0.0f) {
+                float predicted_rating = weighted_score_sum[movie_idx] / similarity_sum[movie_idx];
+                recommendations.emplace_back(movie_idx, predicted_rating);
             }
         }
     }
+
+    // Limpa apenas as posições tocadas, deixando os acumuladores prontos para a próxima consulta.
+    for (int movie_idx : touched) {
+        weighted_score_sum[movie_idx] = 0.0f;
+        similarity_sum[movie_idx] = 0.0f;
+        movie_state[movie_idx] = 0;
+    }
+    forEachRowEntry(matrix, target_user_idx, [&](uint32_t, int movie_idx) { movie_state[movie_idx] = 0; });
+
+    // Empates são desfeitos pelo índice denso, para que a saída não dependa da ordem de acumulação.
     std::sort(recommendations.begin(), recommendations.end(),
-              [](const auto& a, const auto& b) { return a.second > b.second; });
-    return recommendations;
+              [](const auto& a, const auto& b) {
+                  return a.second > b.second || (a.second == b.second && a.first < b.first);
+              });
+}
+
+void restoreExternalMovieIds(RecommendationList& recommendations, const RatingMatrix& matrix, int top_n) {
+    if (recommendations.size() > static_cast<size_t>(std::max(top_n, 0))) {
+        recommendations.resize(std::max(top_n, 0));
+    }
+    for (auto& rec : recommendations) {
+        rec.first = matrix.movies.toExternal(rec.first);
+    }
 }
 
 // --- Fase 3: Recommendation Generation Functions ---
@@ -405,40 +635,20 @@ std::ofstream prepareRecommendationsOutput(const std::string& output_path,
     return output_file;
 }
 
-std::string processUserRecommendations(
+void appendUserRecommendations(
+    std::string& output,
     int target_user_id,
-    const UserItemMatrix& user_item_matrix,
-    const UserNormsMap& user_norms,
-    const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
-    const MovieTitlesMap& movie_titles,
-    int k_neighbors,
-    int top_n) {
-    
-    // Obter os k vizinhos mais próximos via LSH
-    NeighborList neighbors = findApproximateKNearestNeighborsLSH(
-        target_user_id, user_item_matrix, user_norms,
-        all_hyperplane_sets, lsh_tables, movie_to_idx, k_neighbors);
-    
-    // Calcular a similaridade média dos vizinhos
-    float mean_similarity = 0.0f;
-    if (!neighbors.empty()) {
-        float sum = 0.0f;
-        for (const auto& p : neighbors) sum += p.second;
-        mean_similarity = sum / neighbors.size();
-    }
-    
-    // Gerar recomendações
-    RecommendationList recommendations = generateRecommendationsLSH(
-        target_user_id, k_neighbors, user_item_matrix, user_norms,
-        all_hyperplane_sets, lsh_tables, movie_to_idx, &neighbors, 0.1f, true);
-    
-    // Formatar saída
-    std::ostringstream oss;
-    oss << "User ID: " << target_user_id << " | Similaridade Media: " 
-        << std::fixed << std::setprecision(2) << mean_similarity << "\n";
-    oss << "  Recommended Movies (MovieID: Score | Title):\n";
+    float mean_similarity,
+    const RecommendationList& recommendations,
+    const MovieCatalog& movie_catalog,
+    int top_n,
+    bool degraded) {
+    appendText(output, "User ID: ");
+    appendInt(output, target_user_id);
+    appendText(output, " | Similaridade Media: ");
+    appendFixed(output, mean_similarity, 2);
+    if (degraded) appendText(output, " | Resultado parcial");
+    appendText(output, "\n  Recommended Movies (MovieID: Score | Title):\n");
     
     int count = 0;
     for (const auto& rec : recommendations) {
@@ -448,42 +658,149 @@ std::string processUserRecommendations(
         double score = rec.second;
         double score_percent = (score / 5.0) * 100.0;
         
-        oss << "  - " << movie_id << ": " << std::fixed << std::setprecision(1) 
-            << score_percent << "% | ";
+        appendText(output, "  - ");
+        appendInt(output, movie_id);
+        appendText(output, ": ");
+        appendFixed(output, score_percent, 1);
+        appendText(output, "% | ");
         
-        if (movie_titles.count(movie_id)) {
-            oss << movie_titles.at(movie_id);
+        std::string_view title;
+        if (movie_catalog.findTitle(movie_id, title)) {
+            appendText(output, title);
         } else {
-            oss << "(Title not found)";
+            appendText(output, "(Title not found)");
         }
-        oss << "\n";
+        output += '\n';
     }
-    oss << "\n";
-    
-    return oss.str();
+    output += '\n';
 }
 
-std::vector<std::string> generateRecommendationsForUsers(
-    const std::vector<int>& explore_user_ids,
-    const UserItemMatrix& user_item_matrix,
-    const UserNormsMap& user_norms,
+void appendUserOutput(
+    std::string& output,
+    RecommendationsOutputFormat format,
+    int target_user_id,
+    const NeighborSimilarityStats& neighbor_stats,
+    const RecommendationList& recommendations,
+    const MovieCatalog& movie_catalog,
+    int top_n) {
+    if (format == RecommendationsOutputFormat::BINARY) {
+        appendUserRecommendationsBinary(output, target_user_id, neighbor_stats, recommendations, top_n);
+    } else {
+        appendUserRecommendations(output, target_user_id, neighbor_stats.mean, recommendations, movie_catalog, top_n,
+                                  neighbor_stats.degraded);
+    }
+}
+
+NeighborSimilarityStats computeNeighborSimilarityStats(const NeighborList& neighbors) {
+    NeighborSimilarityStats stats;
+    if (neighbors.empty()) return stats;
+    float sum = 0.0f;
+    stats.min = neighbors.front().second;
+    stats.max = neighbors.front().second;
+    for (const auto& p : neighbors) {
+        sum += p.second;
+        stats.min = std::min(stats.min, p.second);
+        stats.max = std::max(stats.max, p.second);
+    }
+    stats.count = static_cast<uint32_t>(neighbors.size());
+    stats.mean = sum / neighbors.size();
+    return stats;
+}
+
+void processUserRecommendations(
+    int target_user_id,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
     const std::vector<HyperplaneSet>& all_hyperplane_sets,
-    const std::vector<LSHBucketMap>& lsh_tables,
-    const MovieIdToDenseIdxMap& movie_to_idx,
-    const MovieTitlesMap& movie_titles,
+    const std::vector<LSHTable>& lsh_tables,
+    const MovieCatalog& movie_catalog,
     int k_neighbors,
-    int top_n) {
+    int top_n,
+    std::string& output,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter,
+    RecommendationCache* cache,
+    const SimHashSignatures* signatures,
+    const KnnGraph* knn_graph) {
     
-    std::vector<std::string> user_outputs(explore_user_ids.size());
+    // Fronteira de entrada: daqui em diante o usuário é identificado pelo índice denso.
+    const int target_user_idx = matrix.users.toDense(target_user_id);
+    if (target_user_idx < 0) {
+        std::cerr << "Warning: Target user " << target_user_id << " not found for LSH KNN." << std::endl;
+        appendUserOutput(output, format, target_user_id, NeighborSimilarityStats(), RecommendationList(), movie_catalog, top_n);
+        return;
+    }
+
+    // O cache é indexado pelo índice denso do usuário e guarda listas já com MovieIDs.
+    // As recomendações em cache não têm filtro de gêneros; consultas filtradas só reaproveitam os vizinhos.
+    const bool cache_recommendations = cache != nullptr && !genre_filter.isActive();
+
+    // Listas da consulta reaproveitadas entre os usuários da mesma thread: em regime são apenas
+    // esvaziadas, sem liberar e realocar memória a cada usuário.
+    thread_local NeighborList neighbors_storage;
+    thread_local RecommendationList recommendations_storage;
+    NeighborList& neighbors = neighbors_storage;
+    RecommendationList& recommendations = recommendations_storage;
+
+    // Acerto completo no cache: nenhum hash, candidato ou cosseno precisa ser recalculado.
+    NeighborSimilarityStats cached_stats;
+    if (cache_recommendations && cache->lookupRecommendations(target_user_idx, top_n, recommendations, cached_stats)) {
+        appendUserOutput(output, format, target_user_id, cached_stats, recommendations, movie_catalog, top_n);
+        return;
+    }
+
+    // Orçamento da consulta, contado a partir daqui; resultados parciais não entram no cache.
+    QueryBudget budget = QueryBudget::start(std::chrono::microseconds(QUERY_DEADLINE_MICROSECONDS),
+                                            QUERY_MAX_CANDIDATE_EVALUATIONS);
+
+    // Obter os k vizinhos mais próximos do grafo kNN, via LSH ou do cache
+    if (knn_graph && !knn_graph->empty()) {
+        knn_graph->neighborsOf(target_user_idx, k_neighbors, neighbors);
+    } else if (!cache || !cache->lookupNeighbors(target_user_idx, neighbors)) {
+        findApproximateKNearestNeighborsLSH(
+            target_user_idx, matrix, user_norms,
+            all_hyperplane_sets, lsh_tables, k_neighbors, neighbors, signatures,
+            LSH_MIN_CANDIDATE_COLLISIONS, LSH_MAX_EXACT_CANDIDATES, &budget);
+        if (cache && !budget.degraded) cache->storeNeighbors(target_user_idx, neighbors);
+    }
     
-    #pragma omp parallel for schedule(dynamic)
-    for (size_t idx = 0; idx < explore_user_ids.size(); ++idx) {
-        int target_user_id = explore_user_ids[idx];
-        user_outputs[idx] = processUserRecommendations(
-            target_user_id, user_item_matrix, user_norms,
-            all_hyperplane_sets, lsh_tables, movie_to_idx, movie_titles,
-            k_neighbors, top_n);
+    // Gerar recomendações e restaurar os MovieIDs (fronteira de saída)
+    generateRecommendationsLSH(
+        target_user_idx, k_neighbors, matrix, user_norms,
+        all_hyperplane_sets, lsh_tables, recommendations, &neighbors, 0.1f, true, genre_filter,
+        nullptr, &budget);
+    restoreExternalMovieIds(recommendations, matrix, top_n);
+
+    // Estatísticas das similaridades dos vizinhos (média, mínimo e máximo)
+    NeighborSimilarityStats neighbor_stats = computeNeighborSimilarityStats(neighbors);
+    neighbor_stats.degraded = budget.degraded;
+    if (cache_recommendations && !budget.degraded) {
+        cache->storeRecommendations(target_user_idx, top_n, recommendations, neighbor_stats);
     }
     
-    return user_outputs;
-}
\ No newline at end of file
+    appendUserOutput(output, format, target_user_id, neighbor_stats, recommendations, movie_catalog, top_n);
+}
+
+void generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RatingMatrix& matrix,
+    const UserNormsVec& user_norms,
+    const std::vector<HyperplaneSet>& all_hyperplane_sets,
+    const std::vector<LSHTable>& lsh_tables,
+    const MovieCatalog& movie_catalog,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter,
+    RecommendationCache* cache,
+    const SimHashSignatures* signatures,
+    const KnnGraph* knn_graph) {
+    
+    streamOrderedUserOutputs(explore_user_ids.size(), [&](size_t idx, std::string& output) {
+        processUserRecommendations(
+            explore_user_ids[idx], matrix, user_norms,
+            all_hyperplane_sets, lsh_tables, movie_catalog,
+            k_neighbors, top_n, output, format, genre_filter, cache, signatures, knn_graph);
+    }, writer, OUTPUT_USERS_PER_BATCH);
+}
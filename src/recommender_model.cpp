@@ -0,0 +1,206 @@
+#include "../include/recommender_model.hpp"
+#include "../include/recommender_engine.hpp"
+#include "../include/simhash.hpp"
+#include "../include/pipeline.hpp"
+#include "../include/memory_placement.hpp"
+#include "../include/compressed_rows.hpp"
+#include "../include/similarity_policies.hpp"
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+
+bool RecommenderModel::recommend(int user_id, const LSHQueryOptions& options, RecommendationQueryResult& result) const {
+    result.neighbors.clear();
+    result.recommendations.clear();
+    result.neighbor_stats = NeighborSimilarityStats();
+
+    const int target_user_idx = matrix_.users.toDense(user_id);
+    if (target_user_idx < 0) return false;
+
+    QueryBudget budget = QueryBudget::start(options.deadline, options.max_candidate_evaluations);
+    if (!knn_graph_.empty()) {
+        knn_graph_.neighborsOf(target_user_idx, options.k_neighbors, result.neighbors);
+    } else {
+        findApproximateKNearestNeighborsLSH(
+            target_user_idx, matrix_, user_norms_, hyperplane_sets_, lsh_tables_, options.k_neighbors,
+            result.neighbors, simHashSignaturesOrNull(),
+            LSH_MIN_CANDIDATE_COLLISIONS, LSH_MAX_EXACT_CANDIDATES, &budget);
+    }
+    generateRecommendationsLSH(
+        target_user_idx, options.k_neighbors, matrix_, user_norms_, hyperplane_sets_, lsh_tables_,
+        result.recommendations, &result.neighbors, options.similarity_threshold,
+        options.use_user_mean_filter, options.genre_filter, nullptr, &budget);
+    restoreExternalMovieIds(result.recommendations, matrix_, options.top_n);
+
+    result.neighbor_stats = computeNeighborSimilarityStats(result.neighbors);
+    result.neighbor_stats.degraded = budget.degraded;
+    return true;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setRatings(const UserRatingsLog& users_ratings_log,
+                                                             const std::unordered_set<int>& valid_movie_ids) {
+    users_ratings_log_ = &users_ratings_log;
+    valid_movie_ids_ = &valid_movie_ids;
+    return *this;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setMovieCatalog(MovieCatalog movie_catalog) {
+    movie_catalog_ = std::move(movie_catalog);
+    return *this;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setLSHParameters(int num_tables, int num_hyperplanes_per_table, uint32_t seed) {
+    num_tables_ = num_tables;
+    num_hyperplanes_per_table_ = num_hyperplanes_per_table;
+    seed_ = seed;
+    return *this;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setRatingStorage(bool quantize_ratings, bool compress_rows) {
+    quantize_ratings_ = quantize_ratings;
+    compress_rows_ = compress_rows;
+    return *this;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setBucketStorage(bool compress_buckets) {
+    compress_buckets_ = compress_buckets;
+    return *this;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setSimHashSignatureBits(int num_bits) {
+    simhash_bits_ = num_bits;
+    return *this;
+}
+
+RecommenderModelBuilder& RecommenderModelBuilder::setKnnGraphNeighbors(int k) {
+    knn_graph_k_ = k;
+    return *this;
+}
+
+void RecommenderModelBuilder::placeModelMemory(RecommenderModel& model, MemoryPlacementPolicy policy, bool huge_pages) {
+    // Arrays lidos por todas as threads em todas as consultas (proporcionais a avaliações ou usuários).
+    // Estruturas pequenas (hiperplanos, offsets dos buckets) ficam nos caches de cada núcleo e não
+    // precisam de réplicas por nó.
+    RatingMatrix& matrix = model.matrix_;
+    placeReadMostlyArray(matrix.row_offsets, policy, huge_pages);
+    placeReadMostlyArray(matrix.row_movies, policy, huge_pages);
+    placeReadMostlyArray(matrix.row_movie_bytes, policy, huge_pages);
+    placeReadMostlyArray(matrix.row_movie_byte_offsets, policy, huge_pages);
+    placeReadMostlyArray(matrix.row_ratings, policy, huge_pages);
+    placeReadMostlyArray(matrix.row_rating_units, policy, huge_pages);
+    placeReadMostlyArray(model.user_norms_, policy, huge_pages);
+    placeReadMostlyArray(matrix.user_means, policy, huge_pages);
+    placeReadMostlyArray(matrix.user_centered_norms, policy, huge_pages);
+    for (const LSHTable& table : model.lsh_tables_) {
+        placeReadMostlyArray(table.bucket_users, policy, huge_pages);
+        placeReadMostlyArray(table.bucket_user_bytes, policy, huge_pages);
+        placeReadMostlyArray(table.user_buckets, policy, huge_pages);
+    }
+    placeReadMostlyArray(model.simhash_signatures_.words, policy, huge_pages);
+    placeReadMostlyArray(model.knn_graph_.neighbor_users, policy, huge_pages);
+    placeReadMostlyArray(model.knn_graph_.neighbor_similarities, policy, huge_pages);
+}
+
+std::shared_ptr<const RecommenderModel> RecommenderModelBuilder::build() {
+    if (!users_ratings_log_ || !valid_movie_ids_) {
+        std::cerr << "Erro: RecommenderModelBuilder sem avaliações (setRatings não foi chamado)." << std::endl;
+        return nullptr;
+    }
+    // make_shared não alcança o construtor privado.
+    std::shared_ptr<RecommenderModel> model(new RecommenderModel());
+
+    // Os hiperplanos só dependem do número de filmes (um índice denso por filme válido), então
+    // são sorteados em paralelo com a conversão da matriz.
+    std::mt19937 rng(seed_);
+    const int expected_movies = static_cast<int>(valid_movie_ids_->size());
+    std::future<void> hyperplanes_stage = startPipelineStage([&] {
+        model->hyperplane_sets_.reserve(num_tables_);
+        for (int i = 0; i < num_tables_; ++i) {
+            model->hyperplane_sets_.push_back(generateSingleHyperplaneSet(num_hyperplanes_per_table_, expected_movies, rng));
+        }
+    });
+
+    // Única tradução de IDs externos: daqui em diante usuários e filmes são índices densos.
+    model->matrix_ = buildRatingMatrix(*users_ratings_log_, *valid_movie_ids_, quantize_ratings_, compress_rows_);
+    attachMovieGenres(model->matrix_, movie_catalog_);
+    model->movie_catalog_ = std::move(movie_catalog_);
+    model->user_norms_ = computeUserNorms(model->matrix_);
+    if (ConfiguredSimilarity::needs_user_means) attachUserSimilarityTerms(model->matrix_);
+    hyperplanes_stage.get();
+
+    const int D = model->matrix_.numMovies();
+    if (D != expected_movies) {
+        // IDs inválidos (negativos) não viram índices: sorteia de novo com a dimensão real.
+        rng.seed(seed_);
+        model->hyperplane_sets_.clear();
+        for (int i = 0; i < num_tables_; ++i) {
+            model->hyperplane_sets_.push_back(generateSingleHyperplaneSet(num_hyperplanes_per_table_, D, rng));
+        }
+    }
+    buildLSHTables(model->matrix_, model->hyperplane_sets_, model->lsh_tables_);
+
+    // Assinaturas SimHash longas para o pré-filtro de candidatos por popcount.
+    if (simhash_bits_ > 0) {
+        model->simhash_signatures_ = buildSimHashSignatures(model->matrix_, simhash_bits_, rng());
+    }
+
+    // Grafo kNN offline: vizinhos de todos os usuários, semeados pelas tabelas recém-construídas.
+    if (knn_graph_k_ > 0) {
+        model->knn_graph_ = buildKnnGraphNNDescent(
+            model->matrix_, model->user_norms_, model->lsh_tables_, knn_graph_k_,
+            KNN_GRAPH_MAX_ITERATIONS, KNN_GRAPH_SAMPLE_RATE, KNN_GRAPH_EARLY_STOP, seed_);
+    }
+
+    // Depois de todos os usos na construção (o grafo sorteia membros por posição), as listas dos
+    // buckets passam a ser comprimidas.
+    if (compress_buckets_) compressLSHBuckets(model->lsh_tables_);
+
+    // Opcional: redistribui os arrays somente-leitura entre os nós NUMA e/ou em huge pages.
+    if (MEMORY_PLACEMENT != MemoryPlacementPolicy::OS_DEFAULT || USE_HUGE_PAGES) {
+        placeModelMemory(*model, MEMORY_PLACEMENT, USE_HUGE_PAGES);
+    }
+
+    users_ratings_log_ = nullptr;
+    valid_movie_ids_ = nullptr;
+    return model;
+}
+
+void generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const RecommenderModel& model,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter,
+    RecommendationCache* cache) {
+    generateRecommendationsForUsers(
+        explore_user_ids, model.ratingMatrix(), model.userNorms(),
+        model.hyperplaneSets(), model.lshTables(), model.movieCatalog(),
+        k_neighbors, top_n, writer, format, genre_filter, cache,
+        model.simHashSignaturesOrNull(), model.knnGraphOrNull());
+}
+
+std::vector<int> bucketLocalityUserOrder(const RecommenderModel& model) {
+    const RatingMatrix& matrix = model.ratingMatrix();
+    const std::vector<LSHTable>& tables = model.lshTables();
+    const int U = matrix.numUsers();
+
+    std::vector<int> order(U);
+    std::iota(order.begin(), order.end(), 0);
+    if (!tables.empty() && tables[0].user_buckets.size() == static_cast<size_t>(U)) {
+        // Chave (bucket na tabela 0, bucket na tabela 1); empates pelo índice denso.
+        const std::vector<uint32_t>& first = tables[0].user_buckets;
+        const bool has_second = tables.size() > 1 && tables[1].user_buckets.size() == static_cast<size_t>(U);
+        std::vector<uint64_t> keys(U);
+        for (int u = 0; u < U; ++u) {
+            keys[u] = (static_cast<uint64_t>(first[u]) << 32) | (has_second ? tables[1].user_buckets[u] : 0u);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return keys[a] != keys[b] ? keys[a] < keys[b] : a < b;
+        });
+    }
+    for (int& u : order) u = matrix.users.toExternal(u);
+    return order;
+}
@@ -0,0 +1,419 @@
+#include "../include/shard_workers.hpp"
+#include "../include/recommender_engine.hpp"
+#include "../include/output_writer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+const char* const SHARD_WORKER_FLAG = "--shard-worker";
+
+enum ShardMessageType : uint32_t {
+    SHARD_WORKER_READY = 0,    // Worker -> coordenador: shards abertos (count = shards mapeados)
+    SHARD_FIND_NEIGHBORS = 1,  // Perfis -> top-K parcial de cada um
+    SHARD_ACCUMULATE_SCORES = 2 // Perfis e vizinhos -> contribuições por filme
+};
+
+struct ShardMessageHeader {
+    uint32_t type;
+    uint32_t count;          // Número de alvos na mensagem
+    uint64_t payload_bytes;
+};
+
+// --- Serialização (mesma máquina: tipos nativos, sem conversão de endianness) ---
+
+template <typename T>
+void appendPod(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void appendArray(std::string& out, const std::vector<T>& array) {
+    appendPod(out, static_cast<uint32_t>(array.size()));
+    out.append(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+}
+
+class PayloadReader {
+public:
+    explicit PayloadReader(const std::string& payload) : pos_(payload.data()), end_(payload.data() + payload.size()) {}
+
+    template <typename T>
+    bool read(T& value) {
+        if (static_cast<size_t>(end_ - pos_) < sizeof(T)) return false;
+        std::memcpy(&value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool readArray(std::vector<T>& array) {
+        uint32_t size = 0;
+        if (!read(size) || static_cast<size_t>(end_ - pos_) < size * sizeof(T)) return false;
+        array.resize(size);
+        std::memcpy(array.data(), pos_, size * sizeof(T));
+        pos_ += size * sizeof(T);
+        return true;
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+};
+
+void appendProfile(std::string& out, const ShardedTargetProfile& profile) {
+    appendPod(out, static_cast<int32_t>(profile.user_idx));
+    appendPod(out, profile.norm);
+    appendArray(out, profile.buckets);
+    appendArray(out, profile.movies);
+    appendArray(out, profile.rating_units);
+    appendArray(out, profile.ratings);
+}
+
+bool readProfile(PayloadReader& reader, ShardedTargetProfile& profile) {
+    int32_t user_idx = -1;
+    bool ok = reader.read(user_idx) && reader.read(profile.norm) && reader.readArray(profile.buckets) &&
+              reader.readArray(profile.movies) && reader.readArray(profile.rating_units) &&
+              reader.readArray(profile.ratings);
+    profile.user_idx = user_idx;
+    return ok;
+}
+
+void appendNeighbors(std::string& out, const NeighborList& neighbors) {
+    appendPod(out, static_cast<uint32_t>(neighbors.size()));
+    for (const auto& [user_idx, similarity] : neighbors) {
+        appendPod(out, static_cast<int32_t>(user_idx));
+        appendPod(out, similarity);
+    }
+}
+
+// Acrescenta (não substitui) as entradas lidas à lista.
+bool readNeighbors(PayloadReader& reader, NeighborList& neighbors) {
+    uint32_t size = 0;
+    if (!reader.read(size)) return false;
+    for (uint32_t i = 0; i < size; ++i) {
+        int32_t user_idx;
+        float similarity;
+        if (!reader.read(user_idx) || !reader.read(similarity)) return false;
+        neighbors.emplace_back(user_idx, similarity);
+    }
+    return true;
+}
+
+// --- Transporte: mensagens com cabeçalho fixo sobre um socket Unix (SOCK_STREAM) ---
+
+bool sendAll(int socket, const void* data, size_t bytes) {
+    const char* pos = static_cast<const char*>(data);
+    while (bytes > 0) {
+        // MSG_NOSIGNAL: um worker que morreu vira erro de escrita, não SIGPIPE.
+        ssize_t sent = send(socket, pos, bytes, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        pos += sent;
+        bytes -= sent;
+    }
+    return true;
+}
+
+bool receiveAll(int socket, void* data, size_t bytes) {
+    char* pos = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t received = recv(socket, pos, bytes, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        pos += received;
+        bytes -= received;
+    }
+    return true;
+}
+
+bool sendMessage(int socket, uint32_t type, uint32_t count, const std::string& payload) {
+    ShardMessageHeader header{type, count, payload.size()};
+    return sendAll(socket, &header, sizeof(header)) && sendAll(socket, payload.data(), payload.size());
+}
+
+bool receiveMessage(int socket, ShardMessageHeader& header, std::string& payload) {
+    if (!receiveAll(socket, &header, sizeof(header))) return false;
+    payload.resize(header.payload_bytes);
+    return receiveAll(socket, payload.data(), payload.size());
+}
+
+/**
+ * @brief Soma, em ordem, as contribuições de um mesmo filme vindas de workers diferentes.
+ * @details A primeira ocorrência de cada filme guarda a soma; a lista é compactada no lugar.
+ */
+void mergeMovieScorePartials(std::vector<MovieScorePartial>& partials, int num_movies) {
+    thread_local std::vector<int> merged_position; // Filme -> posição na lista compactada (-1: ausente)
+    if (static_cast<int>(merged_position.size()) != num_movies) merged_position.assign(num_movies, -1);
+    size_t num_merged = 0;
+    for (size_t i = 0; i < partials.size(); ++i) {
+        const MovieScorePartial partial = partials[i];
+        int& position = merged_position[partial.movie_idx];
+        if (position < 0) {
+            position = static_cast<int>(num_merged);
+            partials[num_merged++] = partial;
+        } else {
+            partials[position].weighted_score_sum += partial.weighted_score_sum;
+            partials[position].similarity_sum += partial.similarity_sum;
+        }
+    }
+    partials.resize(num_merged);
+    for (const MovieScorePartial& partial : partials) merged_position[partial.movie_idx] = -1;
+}
+
+} // namespace
+
+bool ShardWorkerPool::start(const std::string& directory, int num_workers) {
+    stop();
+    for (int w = 0; w < num_workers; ++w) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) {
+            std::cerr << "Erro: socketpair() falhou para o worker " << w << ": " << std::strerror(errno) << std::endl;
+            stop();
+            return false;
+        }
+        // Argumentos montados antes do fork: entre fork e exec o filho só faz chamadas async-signal-safe.
+        std::string socket_arg = std::to_string(sockets[1]);
+        std::string worker_arg = std::to_string(w);
+        std::string num_workers_arg = std::to_string(num_workers);
+        char* const worker_argv[] = {const_cast<char*>("recommender"), const_cast<char*>(SHARD_WORKER_FLAG),
+                                     socket_arg.data(), worker_arg.data(), num_workers_arg.data(),
+                                     const_cast<char*>(directory.c_str()), nullptr};
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Só a ponta do worker sobrevive ao exec; as dos outros workers são CLOEXEC.
+            fcntl(sockets[1], F_SETFD, 0);
+            execv("/proc/self/exe", worker_argv);
+            _exit(127);
+        }
+        close(sockets[1]);
+        if (pid < 0) {
+            close(sockets[0]);
+            std::cerr << "Erro: fork() falhou para o worker " << w << ": " << std::strerror(errno) << std::endl;
+            stop();
+            return false;
+        }
+        workers_.push_back({pid, sockets[0]});
+    }
+
+    ShardMessageHeader header;
+    std::string payload;
+    for (int w = 0; w < numWorkers(); ++w) {
+        if (!receiveMessage(workers_[w].socket, header, payload) || header.type != SHARD_WORKER_READY) {
+            std::cerr << "Erro: o worker " << w << " não abriu os shards de " << directory << std::endl;
+            stop();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShardWorkerPool::stop() {
+    for (Worker& worker : workers_) {
+        if (worker.socket != -1) close(worker.socket);
+    }
+    for (Worker& worker : workers_) {
+        while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) {}
+    }
+    workers_.clear();
+}
+
+bool ShardWorkerPool::broadcast(uint32_t type, uint32_t count, const std::string& payload) {
+    // Todos os workers recebem o lote antes de qualquer resposta ser lida: calculam em paralelo.
+    for (int w = 0; w < numWorkers(); ++w) {
+        if (!sendMessage(workers_[w].socket, type, count, payload)) {
+            std::cerr << "Erro: falha ao enviar o lote ao worker " << w << "." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShardWorkerPool::findNeighbors(const std::vector<ShardedTargetProfile>& profiles, int K,
+                                    std::vector<NeighborList>& neighbors) {
+    std::string payload;
+    appendPod(payload, static_cast<int32_t>(K));
+    for (const ShardedTargetProfile& profile : profiles) appendProfile(payload, profile);
+    if (!broadcast(SHARD_FIND_NEIGHBORS, static_cast<uint32_t>(profiles.size()), payload)) return false;
+
+    neighbors.resize(profiles.size());
+    for (NeighborList& list : neighbors) list.clear();
+    ShardMessageHeader header;
+    for (int w = 0; w < numWorkers(); ++w) {
+        if (!receiveMessage(workers_[w].socket, header, payload) || header.count != profiles.size()) {
+            std::cerr << "Erro: resposta inválida do worker " << w << "." << std::endl;
+            return false;
+        }
+        PayloadReader reader(payload);
+        for (NeighborList& list : neighbors) {
+            if (!readNeighbors(reader, list)) return false;
+        }
+    }
+    // Os K melhores de cada worker contêm os K melhores globais.
+    for (NeighborList& list : neighbors) {
+        std::sort(list.begin(), list.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+        if (list.size() > static_cast<size_t>(K)) list.resize(K);
+    }
+    return true;
+}
+
+bool ShardWorkerPool::accumulateScores(const std::vector<ShardedTargetProfile>& profiles,
+                                       const std::vector<NeighborList>& neighbors, float similarity_threshold,
+                                       const GenreFilter& genre_filter,
+                                       std::vector<std::vector<MovieScorePartial>>& partials) {
+    std::string payload;
+    appendPod(payload, similarity_threshold);
+    appendPod(payload, genre_filter.include_mask);
+    appendPod(payload, genre_filter.exclude_mask);
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        appendProfile(payload, profiles[i]);
+        appendNeighbors(payload, neighbors[i]);
+    }
+    if (!broadcast(SHARD_ACCUMULATE_SCORES, static_cast<uint32_t>(profiles.size()), payload)) return false;
+
+    partials.resize(profiles.size());
+    for (auto& list : partials) list.clear();
+    ShardMessageHeader header;
+    std::vector<MovieScorePartial> worker_partials;
+    for (int w = 0; w < numWorkers(); ++w) {
+        if (!receiveMessage(workers_[w].socket, header, payload) || header.count != profiles.size()) {
+            std::cerr << "Erro: resposta inválida do worker " << w << "." << std::endl;
+            return false;
+        }
+        PayloadReader reader(payload);
+        for (auto& list : partials) {
+            if (!reader.readArray(worker_partials)) return false;
+            list.insert(list.end(), worker_partials.begin(), worker_partials.end());
+        }
+    }
+    return true;
+}
+
+bool isShardWorkerInvocation(int argc, char* argv[]) {
+    return argc > 1 && std::strcmp(argv[1], SHARD_WORKER_FLAG) == 0;
+}
+
+int runShardWorker(int argc, char* argv[]) {
+    // recommender --shard-worker <socket> <worker> <num_workers> <diretório>
+    if (argc != 6) {
+        std::cerr << "Uso: " << argv[0] << " " << SHARD_WORKER_FLAG << " <socket> <worker> <workers> <diretório>" << std::endl;
+        return 1;
+    }
+    const int socket = std::atoi(argv[2]);
+    const int worker = std::atoi(argv[3]);
+    const int num_workers = std::max(std::atoi(argv[4]), 1);
+    ShardedModel model;
+    if (!model.open(argv[5], worker, num_workers)) return 1;
+
+    // Os workers dividem os núcleos da máquina entre si.
+    #ifdef _OPENMP
+        omp_set_num_threads(std::max(1, omp_get_num_procs() / num_workers));
+    #endif
+    int mapped_shards = 0;
+    for (int s = 0; s < model.numShards(); ++s) mapped_shards += model.isShardMapped(s) ? 1 : 0;
+    if (!sendMessage(socket, SHARD_WORKER_READY, static_cast<uint32_t>(mapped_shards), std::string())) return 1;
+
+    ShardMessageHeader header;
+    std::string request, reply;
+    std::vector<ShardedTargetProfile> profiles;
+    std::vector<NeighborList> neighbors;
+    std::vector<std::vector<MovieScorePartial>> partials;
+    // O fim do fluxo (coordenador fechou o socket) encerra o worker normalmente.
+    while (receiveMessage(socket, header, request)) {
+        PayloadReader reader(request);
+        profiles.resize(header.count);
+        neighbors.resize(header.count);
+        reply.clear();
+        if (header.type == SHARD_FIND_NEIGHBORS) {
+            int32_t K = 0;
+            bool ok = reader.read(K);
+            for (uint32_t i = 0; i < header.count && ok; ++i) ok = readProfile(reader, profiles[i]);
+            if (!ok) break;
+            #pragma omp parallel for schedule(dynamic)
+            for (uint32_t i = 0; i < header.count; ++i) model.scoreCandidates(profiles[i], K, neighbors[i]);
+            for (uint32_t i = 0; i < header.count; ++i) appendNeighbors(reply, neighbors[i]);
+        } else if (header.type == SHARD_ACCUMULATE_SCORES) {
+            float similarity_threshold = 0.0f;
+            GenreFilter genre_filter;
+            bool ok = reader.read(similarity_threshold) && reader.read(genre_filter.include_mask) &&
+                      reader.read(genre_filter.exclude_mask);
+            for (uint32_t i = 0; i < header.count && ok; ++i) {
+                neighbors[i].clear();
+                ok = readProfile(reader, profiles[i]) && readNeighbors(reader, neighbors[i]);
+            }
+            if (!ok) break;
+            partials.resize(header.count);
+            #pragma omp parallel for schedule(dynamic)
+            for (uint32_t i = 0; i < header.count; ++i) {
+                partials[i].clear();
+                if (profiles[i].user_idx >= 0) {
+                    model.accumulateScores(profiles[i], neighbors[i], similarity_threshold, genre_filter, partials[i]);
+                }
+            }
+            for (uint32_t i = 0; i < header.count; ++i) appendArray(reply, partials[i]);
+        } else {
+            break;
+        }
+        if (!sendMessage(socket, header.type, header.count, reply)) break;
+    }
+    close(socket);
+    return 0;
+}
+
+bool generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const ShardedModel& model,
+    ShardWorkerPool& workers,
+    const MovieCatalog& movie_catalog,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter) {
+    std::vector<ShardedTargetProfile> profiles;
+    std::vector<NeighborList> neighbors;
+    std::vector<std::vector<MovieScorePartial>> partials;
+    std::vector<RecommendationList> recommendations;
+
+    // Um lote por rodada de mensagens: a latência do IPC é paga uma vez por lote, não por usuário.
+    for (size_t batch_start = 0; batch_start < explore_user_ids.size(); batch_start += OUTPUT_USERS_PER_BATCH) {
+        const size_t batch_size = std::min(OUTPUT_USERS_PER_BATCH, explore_user_ids.size() - batch_start);
+        profiles.resize(batch_size);
+        for (size_t i = 0; i < batch_size; ++i) {
+            const int target_user_id = explore_user_ids[batch_start + i];
+            if (!model.loadTargetProfile(model.toDenseUser(target_user_id), profiles[i])) {
+                std::cerr << "Warning: Target user " << target_user_id << " not found in the sharded model." << std::endl;
+            }
+        }
+        if (!workers.findNeighbors(profiles, k_neighbors, neighbors) ||
+            !workers.accumulateScores(profiles, neighbors, 0.1f, genre_filter, partials)) {
+            return false;
+        }
+
+        recommendations.resize(batch_size);
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < batch_size; ++i) {
+            mergeMovieScorePartials(partials[i], model.numMovies());
+            ShardedModel::finishRecommendations(profiles[i], partials[i], true, recommendations[i]);
+            model.restoreExternalMovieIds(recommendations[i], top_n);
+        }
+
+        streamOrderedUserOutputs(batch_size, [&](size_t i, std::string& output) {
+            appendUserOutput(output, format, explore_user_ids[batch_start + i],
+                             computeNeighborSimilarityStats(neighbors[i]), recommendations[i], movie_catalog, top_n);
+        }, writer, batch_size);
+    }
+    return true;
+}
@@ -0,0 +1,560 @@
+#include "../include/sharded_model.hpp"
+#include "../include/recommender_model.hpp"
+#include "../include/recommender_engine.hpp"
+#include "../include/compressed_rows.hpp"
+#include "../include/output_writer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+const char SHARD_DIRECTORY_MAGIC[8] = {'L', 'S', 'H', 'S', 'D', 'I', 'R', '1'};
+const char SHARD_FILE_MAGIC[8] = {'L', 'S', 'H', 'S', 'H', 'R', 'D', '1'};
+
+// Os arrays de cada shard começam em múltiplos de 64 bytes (linha de cache).
+constexpr size_t SHARD_ARRAY_ALIGNMENT = 64;
+
+struct ShardDirectoryHeader {
+    char magic[8];
+    uint32_t num_shards;
+    uint32_t num_users;
+    uint32_t num_movies;
+    uint32_t num_tables;
+    uint32_t num_buckets;
+    uint32_t quantized;
+    uint32_t has_genres;
+    uint32_t reserved;
+};
+
+struct ShardFileHeader {
+    char magic[8];
+    uint32_t first_user;
+    uint32_t num_users;
+    uint64_t num_ratings;
+    uint32_t num_tables;
+    uint32_t num_buckets;
+    uint32_t quantized;
+    uint32_t reserved;
+};
+
+// Posição (em bytes, a partir do início do arquivo) de cada array de um shard.
+struct ShardLayout {
+    size_t row_offsets, row_movies, ratings, norms, user_buckets, bucket_offsets, bucket_users, total;
+};
+
+ShardLayout shardLayout(const ShardFileHeader& header) {
+    const size_t n = header.num_users, ratings = header.num_ratings;
+    const size_t tables = header.num_tables, buckets = header.num_buckets;
+    size_t position = sizeof(ShardFileHeader);
+    auto place = [&](size_t bytes) {
+        position = (position + SHARD_ARRAY_ALIGNMENT - 1) / SHARD_ARRAY_ALIGNMENT * SHARD_ARRAY_ALIGNMENT;
+        const size_t start = position;
+        position += bytes;
+        return start;
+    };
+    ShardLayout layout;
+    layout.row_offsets = place((n + 1) * sizeof(uint32_t));
+    layout.row_movies = place(ratings * sizeof(int32_t));
+    layout.ratings = place(ratings * (header.quantized ? sizeof(uint8_t) : sizeof(float)));
+    layout.norms = place(n * sizeof(float));
+    layout.user_buckets = place(tables * n * sizeof(uint32_t));
+    layout.bucket_offsets = place(tables * (buckets + 1) * sizeof(uint32_t));
+    layout.bucket_users = place(tables * n * sizeof(int32_t));
+    layout.total = place(0);
+    return layout;
+}
+
+std::string shardPath(const std::string& directory, int shard) {
+    return directory + "/shard_" + std::to_string(shard) + ".bin";
+}
+
+std::string shardDirectoryPath(const std::string& directory) {
+    return directory + "/directory.bin";
+}
+
+template <typename T>
+void writeArray(std::ofstream& out, const std::vector<T>& array) {
+    out.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+}
+
+template <typename T>
+void readArray(std::ifstream& in, std::vector<T>& array, size_t count) {
+    array.resize(count);
+    in.read(reinterpret_cast<char*>(array.data()), count * sizeof(T));
+}
+
+} // namespace
+
+bool writeShardedModel(const RecommenderModel& model, const std::string& directory, int num_shards) {
+    const RatingMatrix& matrix = model.ratingMatrix();
+    const UserNormsVec& norms = model.userNorms();
+    const std::vector<LSHTable>& tables = model.lshTables();
+    const int U = matrix.numUsers();
+    const int D = matrix.numMovies();
+    const uint32_t L = static_cast<uint32_t>(tables.size());
+    const uint32_t B = tables.empty() ? 0 : static_cast<uint32_t>(tables[0].bucket_offsets.size() - 1);
+    for (const LSHTable& table : tables) {
+        if (table.user_buckets.size() != static_cast<size_t>(U) || table.bucket_offsets.size() != B + 1) {
+            std::cerr << "Erro: tabelas LSH sem o bucket de cada usuário; o modelo não pode ser particionado." << std::endl;
+            return false;
+        }
+    }
+    num_shards = std::max(1, std::min(num_shards, std::max(U, 1)));
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Erro: não foi possível criar o diretório de shards: " << directory << std::endl;
+        return false;
+    }
+
+    std::vector<uint32_t> shard_first_user(num_shards + 1);
+    for (int s = 0; s <= num_shards; ++s) {
+        shard_first_user[s] = static_cast<uint32_t>(static_cast<uint64_t>(U) * s / num_shards);
+    }
+    std::vector<uint32_t> bucket_counts(static_cast<size_t>(num_shards) * L * B, 0);
+    const bool quantized = matrix.isQuantized();
+
+    // Um shard por vez: a memória extra é a de um único shard.
+    std::vector<char> buffer;
+    for (int s = 0; s < num_shards; ++s) {
+        const uint32_t first = shard_first_user[s], last = shard_first_user[s + 1];
+        const uint32_t n = last - first;
+        ShardFileHeader header{};
+        std::memcpy(header.magic, SHARD_FILE_MAGIC, sizeof(header.magic));
+        header.first_user = first;
+        header.num_users = n;
+        header.num_ratings = matrix.row_offsets[last] - matrix.row_offsets[first];
+        header.num_tables = L;
+        header.num_buckets = B;
+        header.quantized = quantized ? 1 : 0;
+        const ShardLayout layout = shardLayout(header);
+        buffer.assign(layout.total, 0);
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        uint32_t* row_offsets = reinterpret_cast<uint32_t*>(buffer.data() + layout.row_offsets);
+        int32_t* row_movies = reinterpret_cast<int32_t*>(buffer.data() + layout.row_movies);
+        float* shard_norms = reinterpret_cast<float*>(buffer.data() + layout.norms);
+        const uint32_t base = matrix.row_offsets[first];
+        for (uint32_t u = 0; u < n; ++u) {
+            row_offsets[u] = matrix.row_offsets[first + u] - base;
+            shard_norms[u] = norms[first + u];
+            forEachRowEntry(matrix, first + u, [&](uint32_t p, int movie_idx) { row_movies[p - base] = movie_idx; });
+        }
+        row_offsets[n] = static_cast<uint32_t>(header.num_ratings);
+        if (quantized) {
+            std::memcpy(buffer.data() + layout.ratings, matrix.row_rating_units.data() + base, header.num_ratings);
+        } else {
+            std::memcpy(buffer.data() + layout.ratings, matrix.row_ratings.data() + base, header.num_ratings * sizeof(float));
+        }
+
+        // Segmentos dos buckets: membros do shard em ordem crescente de índice, por contagem.
+        uint32_t* user_buckets = reinterpret_cast<uint32_t*>(buffer.data() + layout.user_buckets);
+        uint32_t* bucket_offsets = reinterpret_cast<uint32_t*>(buffer.data() + layout.bucket_offsets);
+        int32_t* bucket_users = reinterpret_cast<int32_t*>(buffer.data() + layout.bucket_users);
+        for (uint32_t t = 0; t < L; ++t) {
+            uint32_t* counts = bucket_counts.data() + (static_cast<size_t>(s) * L + t) * B;
+            uint32_t* offsets = bucket_offsets + static_cast<size_t>(t) * (B + 1);
+            for (uint32_t u = 0; u < n; ++u) {
+                const uint32_t bucket = tables[t].user_buckets[first + u];
+                user_buckets[static_cast<size_t>(t) * n + u] = bucket;
+                ++counts[bucket];
+            }
+            for (uint32_t b = 0; b < B; ++b) offsets[b + 1] = offsets[b] + counts[b];
+            std::vector<uint32_t> cursor(offsets, offsets + B);
+            for (uint32_t u = 0; u < n; ++u) {
+                const uint32_t bucket = tables[t].user_buckets[first + u];
+                bucket_users[static_cast<size_t>(t) * n + cursor[bucket]++] = static_cast<int32_t>(first + u);
+            }
+        }
+
+        std::ofstream out(shardPath(directory, s), std::ios::binary);
+        out.write(buffer.data(), buffer.size());
+        if (!out) {
+            std::cerr << "Erro: falha ao gravar o shard " << shardPath(directory, s) << std::endl;
+            return false;
+        }
+    }
+
+    std::ofstream out(shardDirectoryPath(directory), std::ios::binary);
+    if (!out) {
+        std::cerr << "Erro: não foi possível criar o diretório do modelo em shards: " << directory << std::endl;
+        return false;
+    }
+    ShardDirectoryHeader header{};
+    std::memcpy(header.magic, SHARD_DIRECTORY_MAGIC, sizeof(header.magic));
+    header.num_shards = static_cast<uint32_t>(num_shards);
+    header.num_users = static_cast<uint32_t>(U);
+    header.num_movies = static_cast<uint32_t>(D);
+    header.num_tables = L;
+    header.num_buckets = B;
+    header.quantized = quantized ? 1 : 0;
+    header.has_genres = matrix.movie_genres.size() == static_cast<size_t>(D) ? 1 : 0;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeArray(out, shard_first_user);
+    writeArray(out, matrix.users.dense_to_external);
+    writeArray(out, matrix.movies.dense_to_external);
+    if (header.has_genres) writeArray(out, matrix.movie_genres);
+    writeArray(out, bucket_counts);
+    return static_cast<bool>(out);
+}
+
+bool ShardedModel::open(const std::string& directory, int worker, int num_workers) {
+    close();
+    std::ifstream in(shardDirectoryPath(directory), std::ios::binary);
+    if (!in) {
+        std::cerr << "Erro: diretório de shards não encontrado: " << directory << std::endl;
+        return false;
+    }
+    ShardDirectoryHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, SHARD_DIRECTORY_MAGIC, sizeof(header.magic)) != 0 || header.num_shards == 0) {
+        std::cerr << "Erro: diretório de shards inválido: " << directory << std::endl;
+        return false;
+    }
+    std::vector<int> user_ids, movie_ids;
+    readArray(in, shard_first_user_, header.num_shards + 1);
+    readArray(in, user_ids, header.num_users);
+    readArray(in, movie_ids, header.num_movies);
+    if (header.has_genres) readArray(in, movie_genres_, header.num_movies);
+    readArray(in, bucket_counts_, static_cast<size_t>(header.num_shards) * header.num_tables * header.num_buckets);
+    users_ = buildDenseIdMap(user_ids);
+    movies_ = buildDenseIdMap(movie_ids);
+    num_tables_ = static_cast<int>(header.num_tables);
+    num_buckets_ = header.num_buckets;
+    quantized_ = header.quantized != 0;
+    if (!in || users_.size() != static_cast<int>(header.num_users) ||
+        movies_.size() != static_cast<int>(header.num_movies) || shard_first_user_.back() != header.num_users) {
+        std::cerr << "Erro: diretório de shards inconsistente: " << directory << std::endl;
+        close();
+        return false;
+    }
+
+    shards_.resize(header.num_shards);
+    num_workers = std::max(num_workers, 1);
+    for (uint32_t s = 0; s < header.num_shards; ++s) {
+        if (static_cast<int>(s % num_workers) != worker) continue;
+        const std::string path = shardPath(directory, s);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat sb;
+        if (fd == -1 || fstat(fd, &sb) == -1 || static_cast<size_t>(sb.st_size) < sizeof(ShardFileHeader)) {
+            if (fd != -1) ::close(fd);
+            std::cerr << "Erro: shard ausente ou vazio: " << path << std::endl;
+            close();
+            return false;
+        }
+        void* mapping = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Erro: falha no mmap() do shard " << path << std::endl;
+            close();
+            return false;
+        }
+        // Acesso aleatório às linhas: sem leitura antecipada, cada falta traz só a página tocada.
+        madvise(mapping, sb.st_size, MADV_RANDOM);
+
+        Shard& shard = shards_[s];
+        shard.mapping = mapping;
+        shard.mapping_size = sb.st_size;
+        ShardFileHeader shard_header;
+        std::memcpy(&shard_header, mapping, sizeof(shard_header));
+        const ShardLayout layout = shardLayout(shard_header);
+        if (std::memcmp(shard_header.magic, SHARD_FILE_MAGIC, sizeof(shard_header.magic)) != 0 ||
+            shard_header.first_user != shard_first_user_[s] ||
+            shard_header.num_users != shard_first_user_[s + 1] - shard_first_user_[s] ||
+            shard_header.num_tables != header.num_tables || shard_header.num_buckets != header.num_buckets ||
+            shard_header.quantized != header.quantized || layout.total > shard.mapping_size) {
+            std::cerr << "Erro: shard inconsistente com o diretório: " << path << std::endl;
+            close();
+            return false;
+        }
+        const char* bytes = static_cast<const char*>(mapping);
+        shard.first_user = shard_header.first_user;
+        shard.num_users = shard_header.num_users;
+        shard.row_offsets = reinterpret_cast<const uint32_t*>(bytes + layout.row_offsets);
+        shard.row_movies = reinterpret_cast<const int32_t*>(bytes + layout.row_movies);
+        if (quantized_) {
+            shard.row_rating_units = reinterpret_cast<const uint8_t*>(bytes + layout.ratings);
+        } else {
+            shard.row_ratings = reinterpret_cast<const float*>(bytes + layout.ratings);
+        }
+        shard.norms = reinterpret_cast<const float*>(bytes + layout.norms);
+        shard.user_buckets = reinterpret_cast<const uint32_t*>(bytes + layout.user_buckets);
+        shard.bucket_offsets = reinterpret_cast<const uint32_t*>(bytes + layout.bucket_offsets);
+        shard.bucket_users = reinterpret_cast<const int32_t*>(bytes + layout.bucket_users);
+    }
+    return true;
+}
+
+void ShardedModel::close() {
+    for (Shard& shard : shards_) {
+        if (shard.mapping) munmap(shard.mapping, shard.mapping_size);
+    }
+    shards_.clear();
+    users_ = DenseIdMap();
+    movies_ = DenseIdMap();
+    movie_genres_.clear();
+    shard_first_user_.clear();
+    bucket_counts_.clear();
+}
+
+int ShardedModel::shardIndexOf(int user_idx) const {
+    const auto it = std::upper_bound(shard_first_user_.begin(), shard_first_user_.end(), static_cast<uint32_t>(user_idx));
+    return static_cast<int>(it - shard_first_user_.begin()) - 1;
+}
+
+bool ShardedModel::loadTargetProfile(int target_user_idx, ShardedTargetProfile& profile) const {
+    profile.user_idx = -1;
+    if (target_user_idx < 0 || target_user_idx >= numUsers()) return false;
+    const Shard& home = shardOf(target_user_idx);
+    if (!home.mapping) return false;
+    const uint32_t local = target_user_idx - home.first_user;
+    profile.user_idx = target_user_idx;
+    profile.norm = home.norms[local];
+    profile.buckets.resize(num_tables_);
+    for (int t = 0; t < num_tables_; ++t) {
+        profile.buckets[t] = home.user_buckets[static_cast<size_t>(t) * home.num_users + local];
+    }
+    const uint32_t begin = home.row_offsets[local], end = home.row_offsets[local + 1];
+    profile.movies.assign(home.row_movies + begin, home.row_movies + end);
+    if (quantized_) {
+        profile.rating_units.assign(home.row_rating_units + begin, home.row_rating_units + end);
+        profile.ratings.clear();
+    } else {
+        profile.ratings.assign(home.row_ratings + begin, home.row_ratings + end);
+        profile.rating_units.clear();
+    }
+    return true;
+}
+
+void ShardedModel::findNeighbors(int target_user_idx, int K, NeighborList& neighbors) const {
+    thread_local ShardedTargetProfile profile;
+    neighbors.clear();
+    if (loadTargetProfile(target_user_idx, profile)) scoreCandidates(profile, K, neighbors);
+}
+
+void ShardedModel::scoreCandidates(const ShardedTargetProfile& profile, int K, NeighborList& neighbors) const {
+    neighbors.clear();
+    const int target_user_idx = profile.user_idx;
+    if (target_user_idx < 0 || target_user_idx >= numUsers()) return;
+    const uint32_t B = num_buckets_;
+
+    // Planejador: um shard só é visitado se o bucket do alvo tiver membros nele em alguma tabela.
+    thread_local std::vector<int> candidate_storage;
+    std::vector<int>& candidates = candidate_storage;
+    candidates.clear();
+    uint64_t touched = 0;
+    for (int s = 0; s < numShards(); ++s) {
+        const Shard& shard = shards_[s];
+        if (!shard.mapping) continue;
+        const uint32_t* counts = bucket_counts_.data() + static_cast<size_t>(s) * num_tables_ * B;
+        bool relevant = false;
+        for (int t = 0; t < num_tables_ && !relevant; ++t) relevant = counts[t * B + profile.buckets[t]] > 0;
+        if (!relevant) continue;
+        ++touched;
+        for (int t = 0; t < num_tables_; ++t) {
+            const uint32_t* offsets = shard.bucket_offsets + static_cast<size_t>(t) * (B + 1);
+            const int32_t* members = shard.bucket_users + static_cast<size_t>(t) * shard.num_users;
+            for (uint32_t p = offsets[profile.buckets[t]]; p < offsets[profile.buckets[t] + 1]; ++p) {
+                if (members[p] != target_user_idx) candidates.push_back(members[p]);
+            }
+        }
+    }
+    queries_.fetch_add(1, std::memory_order_relaxed);
+    shards_touched_.fetch_add(touched, std::memory_order_relaxed);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Linha do alvo espalhada em um vetor denso; cada candidato custa um acesso por avaliação.
+    thread_local std::vector<uint8_t> dense_units_storage;
+    thread_local std::vector<float> dense_ratings_storage;
+    thread_local NeighborList scored_storage;
+    std::vector<uint8_t>& dense_units = dense_units_storage;
+    std::vector<float>& dense_ratings = dense_ratings_storage;
+    NeighborList& scored = scored_storage;
+    if (quantized_) dense_units.resize(numMovies(), 0);
+    else dense_ratings.resize(numMovies(), 0.0f);
+    for (size_t i = 0; i < profile.movies.size(); ++i) {
+        if (quantized_) dense_units[profile.movies[i]] = profile.rating_units[i];
+        else dense_ratings[profile.movies[i]] = profile.ratings[i];
+    }
+
+    const float target_norm = profile.norm;
+    scored.resize(candidates.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const int candidate_idx = candidates[i];
+        const Shard& shard = shardOf(candidate_idx);
+        const uint32_t local = candidate_idx - shard.first_user;
+        const float candidate_norm = shard.norms[local];
+        float similarity = 0.0f;
+        if (target_norm != 0.0f && candidate_norm != 0.0f) {
+            float dot = 0.0f;
+            if (quantized_) {
+                uint32_t dot_units = 0;
+                for (uint32_t p = shard.row_offsets[local]; p < shard.row_offsets[local + 1]; ++p) {
+                    dot_units += static_cast<uint32_t>(dense_units[shard.row_movies[p]]) * shard.row_rating_units[p];
+                }
+                dot = static_cast<float>(dot_units) * (RATING_UNIT * RATING_UNIT);
+            } else {
+                for (uint32_t p = shard.row_offsets[local]; p < shard.row_offsets[local + 1]; ++p) {
+                    dot += dense_ratings[shard.row_movies[p]] * shard.row_ratings[p];
+                }
+            }
+            similarity = dot / (target_norm * candidate_norm);
+        }
+        scored[i] = similarity > 0.0f ? std::make_pair(candidate_idx, similarity) : std::make_pair(-1, 0.0f);
+    }
+    for (int movie_idx : profile.movies) {
+        if (quantized_) dense_units[movie_idx] = 0;
+        else dense_ratings[movie_idx] = 0.0f;
+    }
+
+    for (const auto& entry : scored) {
+        if (entry.first != -1) neighbors.push_back(entry);
+    }
+    std::sort(neighbors.begin(), neighbors.end(),
+              [](const auto& a, const auto& b) { return a.second > b.second; });
+    if (neighbors.size() > static_cast<size_t>(K)) neighbors.resize(K);
+}
+
+void ShardedModel::recommend(int target_user_idx, const NeighborList& neighbors, float similarity_threshold,
+                             bool use_user_mean_filter, const GenreFilter& genre_filter,
+                             RecommendationList& recommendations) const {
+    thread_local ShardedTargetProfile profile;
+    thread_local std::vector<MovieScorePartial> partials;
+    recommendations.clear();
+    if (neighbors.empty() || !loadTargetProfile(target_user_idx, profile)) return;
+    accumulateScores(profile, neighbors, similarity_threshold, genre_filter, partials);
+    finishRecommendations(profile, partials, use_user_mean_filter, recommendations);
+}
+
+void ShardedModel::accumulateScores(const ShardedTargetProfile& profile, const NeighborList& neighbors,
+                                    float similarity_threshold, const GenreFilter& genre_filter,
+                                    std::vector<MovieScorePartial>& partials) const {
+    partials.clear();
+    // Acumuladores densos por thread, como em generateRecommendationsLSH. movie_state marca os
+    // filmes já vistos pelo alvo (1) e os que já receberam alguma contribuição (2).
+    const int D = numMovies();
+    thread_local std::vector<float> weighted_score_sum;
+    thread_local std::vector<float> similarity_sum;
+    thread_local std::vector<char> movie_state;
+    thread_local std::vector<int> touched;
+    if (static_cast<int>(weighted_score_sum.size()) != D) {
+        weighted_score_sum.assign(D, 0.0f);
+        similarity_sum.assign(D, 0.0f);
+        movie_state.assign(D, 0);
+    }
+    touched.clear();
+    for (int movie_idx : profile.movies) movie_state[movie_idx] = 1;
+
+    const bool filter_genres = genre_filter.isActive() && !movie_genres_.empty();
+    for (const auto& [neighbor_idx, similarity_score] : neighbors) {
+        if (similarity_score < similarity_threshold) continue;
+        const Shard& shard = shardOf(neighbor_idx);
+        if (!shard.mapping) continue;
+        const uint32_t local = neighbor_idx - shard.first_user;
+        for (uint32_t p = shard.row_offsets[local]; p < shard.row_offsets[local + 1]; ++p) {
+            const int movie_idx = shard.row_movies[p];
+            if (movie_state[movie_idx] == 1) continue;
+            if (filter_genres && !genre_filter.accepts(movie_genres_[movie_idx])) continue;
+            if (movie_state[movie_idx] == 0) {
+                movie_state[movie_idx] = 2;
+                touched.push_back(movie_idx);
+            }
+            weighted_score_sum[movie_idx] += ratingAt(shard, p) * similarity_score;
+            similarity_sum[movie_idx] += similarity_score;
+        }
+    }
+
+    for (int movie_idx : touched) {
+        partials.push_back({movie_idx, weighted_score_sum[movie_idx], similarity_sum[movie_idx]});
+        weighted_score_sum[movie_idx] = 0.0f;
+        similarity_sum[movie_idx] = 0.0f;
+        movie_state[movie_idx] = 0;
+    }
+    for (int movie_idx : profile.movies) movie_state[movie_idx] = 0;
+}
+
+void ShardedModel::finishRecommendations(const ShardedTargetProfile& profile,
+                                         const std::vector<MovieScorePartial>& partials,
+                                         bool use_user_mean_filter, RecommendationList& recommendations) {
+    recommendations.clear();
+    float user_mean = 0.0f;
+    if (!profile.rating_units.empty()) {
+        for (uint8_t units : profile.rating_units) user_mean += units * RATING_UNIT;
+    } else {
+        for (float rating : profile.ratings) user_mean += rating;
+    }
+    if (!profile.movies.empty()) user_mean /= profile.movies.size();
+
+    for (const MovieScorePartial& partial : partials) {
+        if (partial.similarity_sum > 1.0f) {
+            float predicted_rating = partial.weighted_score_sum / partial.similarity_sum;
+            if (!use_user_mean_filter || predicted_rating > user_mean) {
+                recommendations.emplace_back(partial.movie_idx, predicted_rating);
+            }
+        }
+    }
+    if (recommendations.empty()) {
+        for (const MovieScorePartial& partial : partials) {
+            if (partial.similarity_sum > 0.0f) {
+                recommendations.emplace_back(partial.movie_idx, partial.weighted_score_sum / partial.similarity_sum);
+            }
+        }
+    }
+
+    std::sort(recommendations.begin(), recommendations.end(),
+              [](const auto& a, const auto& b) {
+                  return a.second > b.second || (a.second == b.second && a.first < b.first);
+              });
+}
+
+void ShardedModel::restoreExternalMovieIds(RecommendationList& recommendations, int top_n) const {
+    if (recommendations.size() > static_cast<size_t>(std::max(top_n, 0))) {
+        recommendations.resize(std::max(top_n, 0));
+    }
+    for (auto& rec : recommendations) rec.first = movies_.toExternal(rec.first);
+}
+
+ShardedQueryStats ShardedModel::stats() const {
+    ShardedQueryStats stats;
+    stats.queries = queries_.load(std::memory_order_relaxed);
+    stats.shards_touched = shards_touched_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void generateRecommendationsForUsers(
+    const std::vector<int>& explore_user_ids,
+    const ShardedModel& model,
+    const MovieCatalog& movie_catalog,
+    int k_neighbors,
+    int top_n,
+    AsyncFileWriter& writer,
+    RecommendationsOutputFormat format,
+    const GenreFilter& genre_filter) {
+    streamOrderedUserOutputs(explore_user_ids.size(), [&](size_t idx, std::string& output) {
+        const int target_user_id = explore_user_ids[idx];
+        const int target_user_idx = model.toDenseUser(target_user_id);
+        if (target_user_idx < 0) {
+            std::cerr << "Warning: Target user " << target_user_id << " not found in the sharded model." << std::endl;
+            appendUserOutput(output, format, target_user_id, NeighborSimilarityStats(), RecommendationList(), movie_catalog, top_n);
+            return;
+        }
+        thread_local NeighborList neighbors;
+        thread_local RecommendationList recommendations;
+        model.findNeighbors(target_user_idx, k_neighbors, neighbors);
+        model.recommend(target_user_idx, neighbors, 0.1f, true, genre_filter, recommendations);
+        model.restoreExternalMovieIds(recommendations, top_n);
+        appendUserOutput(output, format, target_user_id, computeNeighborSimilarityStats(neighbors),
+                         recommendations, movie_catalog, top_n);
+    }, writer, OUTPUT_USERS_PER_BATCH);
+}
@@ -0,0 +1,89 @@
+#include "../include/simhash.hpp"
+#include "../include/compressed_rows.hpp"
+#include <vector>
+#include <iostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// splitmix64: gera os sinais dos filmes de forma determinística, sem guardar D x bits floats.
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Sinais (+1/-1) dos 8 bits de cada byte: um byte de sinais vira um vetor de 8 floats.
+struct ByteSignTable {
+    alignas(32) float signs[256][8];
+    ByteSignTable() {
+        for (int byte = 0; byte < 256; ++byte) {
+            for (int b = 0; b < 8; ++b) signs[byte][b] = ((byte >> b) & 1) ? 1.0f : -1.0f;
+        }
+    }
+};
+const ByteSignTable BYTE_SIGNS;
+
+// Soma `rating` nos contadores cujo bit de sinal é 1 e subtrai nos demais.
+inline void accumulateSigned(float* counters, uint64_t signs, float rating) {
+    for (int byte = 0; byte < 8; ++byte) {
+        const float* byte_signs = BYTE_SIGNS.signs[(signs >> (8 * byte)) & 0xff];
+        #pragma omp simd
+        for (int b = 0; b < 8; ++b) counters[8 * byte + b] += rating * byte_signs[b];
+    }
+}
+
+} // namespace
+
+SimHashSignatures buildSimHashSignatures(const RatingMatrix& matrix, int num_bits, uint64_t seed) {
+    SimHashSignatures signatures;
+    if (num_bits <= 0) return signatures;
+    if (num_bits % 64 != 0) {
+        std::cerr << "Aviso: SimHash com " << num_bits << " bits arredondado para múltiplo de 64." << std::endl;
+    }
+    const int num_words = (num_bits + 63) / 64;
+    const int U = matrix.numUsers();
+    const int D = matrix.numMovies();
+    signatures.num_words = num_words;
+    signatures.words.assign(static_cast<size_t>(U) * num_words, 0);
+
+    // Sinais de cada filme: D x num_words palavras (alguns MB), lidas em ordem crescente por linha.
+    std::vector<uint64_t> movie_signs(static_cast<size_t>(D) * num_words);
+    #pragma omp parallel for schedule(static)
+    for (int m = 0; m < D; ++m) {
+        for (int w = 0; w < num_words; ++w) {
+            movie_signs[static_cast<size_t>(m) * num_words + w] =
+                splitMix64(seed ^ (static_cast<uint64_t>(m) * num_words + w));
+        }
+    }
+
+    const bool quantized = matrix.isQuantized();
+    #pragma omp parallel
+    {
+        std::vector<float> counters(64 * num_words);
+        #pragma omp for schedule(dynamic, 64)
+        for (int u = 0; u < U; ++u) {
+            std::fill(counters.begin(), counters.end(), 0.0f);
+            forEachRowEntry(matrix, u, [&](uint32_t p, int movie_idx) {
+                const float rating = quantized ? matrix.row_rating_units[p] * RATING_UNIT : matrix.row_ratings[p];
+                const uint64_t* signs = movie_signs.data() + static_cast<size_t>(movie_idx) * num_words;
+                for (int w = 0; w < num_words; ++w) {
+                    accumulateSigned(counters.data() + 64 * w, signs[w], rating);
+                }
+            });
+            uint64_t* out = signatures.words.data() + static_cast<size_t>(u) * num_words;
+            for (int w = 0; w < num_words; ++w) {
+                uint64_t word = 0;
+                for (int b = 0; b < 64; ++b) {
+                    if (counters[64 * w + b] >= 0.0f) word |= (1ULL << b);
+                }
+                out[w] = word;
+            }
+        }
+    }
+    return signatures;
+}
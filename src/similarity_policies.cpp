@@ -0,0 +1,36 @@
+#include "../include/similarity_policies.hpp"
+#include <algorithm>
+#include <cmath>
+
+void attachUserSimilarityTerms(RatingMatrix& matrix) {
+    const int U = matrix.numUsers();
+    matrix.user_means.assign(U, 0.0f);
+    matrix.user_centered_norms.assign(U, 0.0f);
+
+    // Σ (r - m)² = Σ r² - n·m²; com notas quantizadas as duas somas são inteiras e exatas.
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < U; ++u) {
+        const uint32_t row_begin = matrix.rowBegin(u), row_end = matrix.rowEnd(u);
+        const uint32_t n = row_end - row_begin;
+        if (n == 0) continue;
+        double sum = 0.0, sum_sq = 0.0;
+        if (matrix.isQuantized()) {
+            uint64_t units_sum = 0, units_sum_sq = 0;
+            for (uint32_t p = row_begin; p < row_end; ++p) {
+                const uint32_t units = matrix.row_rating_units[p];
+                units_sum += units;
+                units_sum_sq += units * units;
+            }
+            sum = static_cast<double>(units_sum) * RATING_UNIT;
+            sum_sq = static_cast<double>(units_sum_sq) * (RATING_UNIT * RATING_UNIT);
+        } else {
+            for (uint32_t p = row_begin; p < row_end; ++p) {
+                sum += matrix.row_ratings[p];
+                sum_sq += static_cast<double>(matrix.row_ratings[p]) * matrix.row_ratings[p];
+            }
+        }
+        const double mean = sum / n;
+        matrix.user_means[u] = static_cast<float>(mean);
+        matrix.user_centered_norms[u] = static_cast<float>(std::sqrt(std::max(0.0, sum_sq - n * mean * mean)));
+    }
+}
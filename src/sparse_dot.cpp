@@ -0,0 +1,271 @@
+#include "../include/sparse_dot.hpp"
+#include "../include/config.hpp" // Para SPARSE_DOT_GALLOP_RATIO
+#include "../include/compressed_rows.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPARSE_DOT_X86 1
+#endif
+
+namespace {
+
+#if defined(SPARSE_DOT_X86)
+// Blocos de 4 índices (SSE2, presente em todo x86-64): compara o bloco de `a` com as 4 rotações
+// do bloco de `b`. Um bit i no resultado da rotação r significa idx_a[a + i] == idx_b[b + (i + r) % 4].
+// Ao fim do bloco avança o lado de menor máximo (ou os dois, se empatarem).
+template <typename RatingT, typename AccT>
+AccT simdBlockSse2(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                   const int* idx_b, const RatingT* val_b, uint32_t len_b,
+                   uint32_t& a, uint32_t& b) {
+    AccT dot_product = 0;
+    while (a + 4 <= len_a && b + 4 <= len_b) {
+        __m128i block_a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(idx_a + a));
+        __m128i block_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(idx_b + b));
+        for (int r = 0; r < 4; ++r) {
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block_a, block_b)));
+            while (mask) {
+                int i = __builtin_ctz(mask);
+                mask &= mask - 1;
+                dot_product += static_cast<AccT>(val_a[a + i]) * static_cast<AccT>(val_b[b + ((i + r) & 3)]);
+            }
+            block_b = _mm_shuffle_epi32(block_b, _MM_SHUFFLE(0, 3, 2, 1));
+        }
+        const int max_a = idx_a[a + 3], max_b = idx_b[b + 3];
+        if (max_a <= max_b) a += 4;
+        if (max_b <= max_a) b += 4;
+    }
+    return dot_product;
+}
+
+// Mesmo esquema com blocos de 8 e rotações por _mm256_permutevar8x32_epi32.
+template <typename RatingT, typename AccT>
+__attribute__((target("avx2")))
+AccT simdBlockAvx2(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                   const int* idx_b, const RatingT* val_b, uint32_t len_b,
+                   uint32_t& a, uint32_t& b) {
+    AccT dot_product = 0;
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (a + 8 <= len_a && b + 8 <= len_b) {
+        __m256i block_a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx_a + a));
+        __m256i block_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx_b + b));
+        for (int r = 0; r < 8; ++r) {
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block_a, block_b)));
+            while (mask) {
+                int i = __builtin_ctz(mask);
+                mask &= mask - 1;
+                dot_product += static_cast<AccT>(val_a[a + i]) * static_cast<AccT>(val_b[b + ((i + r) & 7)]);
+            }
+            block_b = _mm256_permutevar8x32_epi32(block_b, rotate);
+        }
+        const int max_a = idx_a[a + 7], max_b = idx_b[b + 7];
+        if (max_a <= max_b) a += 8;
+        if (max_b <= max_a) b += 8;
+    }
+    return dot_product;
+}
+#endif
+
+// Linhas do alvo e do outro usuário já em arrays contíguos, com o kernel escolhido.
+template <typename RatingT, typename AccT>
+AccT dispatchSparseDot(SparseDotKernel kernel,
+                       const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                       const int* idx_b, const RatingT* val_b, uint32_t len_b) {
+    switch (kernel) {
+        case SparseDotKernel::GALLOPING:
+            if (len_a <= len_b) return sparseDotGalloping<RatingT, AccT>(idx_a, val_a, len_a, idx_b, val_b, len_b);
+            return sparseDotGalloping<RatingT, AccT>(idx_b, val_b, len_b, idx_a, val_a, len_a);
+        case SparseDotKernel::SIMD_BLOCK:
+            return sparseDotSimdBlock<RatingT, AccT>(idx_a, val_a, len_a, idx_b, val_b, len_b);
+        default:
+            return sparseDotMerge<RatingT, AccT>(idx_a, val_a, len_a, idx_b, val_b, len_b);
+    }
+}
+
+// Converte o acumulador para a escala das notas: com uint8_t, cada produto vale RATING_UNIT^2.
+inline float toRatingScale(uint32_t dot_units) {
+    return static_cast<float>(dot_units) * (RATING_UNIT * RATING_UNIT);
+}
+inline float toRatingScale(float dot_product) {
+    return dot_product;
+}
+
+} // namespace
+
+template <typename RatingT, typename AccT>
+AccT sparseDotMerge(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                    const int* idx_b, const RatingT* val_b, uint32_t len_b) {
+    AccT dot_product = 0;
+    uint32_t a = 0, b = 0;
+    while (a < len_a && b < len_b) {
+        if (idx_a[a] < idx_b[b]) {
+            ++a;
+        } else if (idx_b[b] < idx_a[a]) {
+            ++b;
+        } else {
+            dot_product += static_cast<AccT>(val_a[a]) * static_cast<AccT>(val_b[b]);
+            ++a;
+            ++b;
+        }
+    }
+    return dot_product;
+}
+
+template <typename RatingT, typename AccT>
+AccT sparseDotSimdBlock(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                        const int* idx_b, const RatingT* val_b, uint32_t len_b) {
+    AccT dot_product = 0;
+    uint32_t a = 0, b = 0;
+#if defined(SPARSE_DOT_X86)
+    if (sparseDotHasAvx2()) {
+        dot_product += simdBlockAvx2<RatingT, AccT>(idx_a, val_a, len_a, idx_b, val_b, len_b, a, b);
+    }
+    dot_product += simdBlockSse2<RatingT, AccT>(idx_a, val_a, len_a, idx_b, val_b, len_b, a, b);
+#endif
+    // Cauda (menos de um bloco em um dos lados) por merge.
+    return dot_product + sparseDotMerge<RatingT, AccT>(idx_a + a, val_a + a, len_a - a,
+                                                       idx_b + b, val_b + b, len_b - b);
+}
+
+template <typename RatingT, typename AccT>
+AccT sparseDotGalloping(const int* idx_a, const RatingT* val_a, uint32_t len_a,
+                        const int* idx_b, const RatingT* val_b, uint32_t len_b) {
+    AccT dot_product = 0;
+    uint32_t b = 0;
+    for (uint32_t a = 0; a < len_a && b < len_b; ++a) {
+        const int target = idx_a[a];
+        // Busca exponencial a partir da posição atual; depois binária no último intervalo.
+        uint32_t bound = 1;
+        while (b + bound < len_b && idx_b[b + bound] < target) bound <<= 1;
+        const int* first = idx_b + b + bound / 2;
+        const int* last = idx_b + std::min(b + bound + 1, len_b);
+        b = static_cast<uint32_t>(std::lower_bound(first, last, target) - idx_b);
+        if (b < len_b && idx_b[b] == target) {
+            dot_product += static_cast<AccT>(val_a[a]) * static_cast<AccT>(val_b[b]);
+            ++b;
+        }
+    }
+    return dot_product;
+}
+
+template <typename RatingT, typename AccT>
+AccT sparseDotDense(const RatingT* dense, const int* idx, const RatingT* val, uint32_t len) {
+    AccT dot_product = 0;
+    // Vetorizado com gather quando a CPU oferece (AVX2/AVX-512).
+    #pragma omp simd reduction(+:dot_product)
+    for (uint32_t i = 0; i < len; ++i) {
+        dot_product += static_cast<AccT>(dense[idx[i]]) * static_cast<AccT>(val[i]);
+    }
+    return dot_product;
+}
+
+template uint32_t sparseDotMerge<uint8_t, uint32_t>(const int*, const uint8_t*, uint32_t, const int*, const uint8_t*, uint32_t);
+template float sparseDotMerge<float, float>(const int*, const float*, uint32_t, const int*, const float*, uint32_t);
+template uint32_t sparseDotSimdBlock<uint8_t, uint32_t>(const int*, const uint8_t*, uint32_t, const int*, const uint8_t*, uint32_t);
+template float sparseDotSimdBlock<float, float>(const int*, const float*, uint32_t, const int*, const float*, uint32_t);
+template uint32_t sparseDotGalloping<uint8_t, uint32_t>(const int*, const uint8_t*, uint32_t, const int*, const uint8_t*, uint32_t);
+template float sparseDotGalloping<float, float>(const int*, const float*, uint32_t, const int*, const float*, uint32_t);
+template uint32_t sparseDotDense<uint8_t, uint32_t>(const uint8_t*, const int*, const uint8_t*, uint32_t);
+template float sparseDotDense<float, float>(const float*, const int*, const float*, uint32_t);
+
+bool sparseDotHasAvx2() {
+#if defined(SPARSE_DOT_X86)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+SparseDotKernel selectSparseDotKernel(uint32_t len_target, uint32_t len_other, bool dense_target_available) {
+    const uint64_t shorter = std::min(len_target, len_other);
+    const uint64_t longer = std::max(len_target, len_other);
+    // Com o alvo espalhado, cada candidato custa um acesso direto por avaliação; só vale trocar
+    // por galloping quando o candidato é muito mais longo que o alvo.
+    if (dense_target_available && len_other < SPARSE_DOT_GALLOP_RATIO * static_cast<uint64_t>(len_target)) {
+        return SparseDotKernel::DENSE_SCATTER;
+    }
+    if (shorter > 0 && longer >= SPARSE_DOT_GALLOP_RATIO * shorter) {
+        return SparseDotKernel::GALLOPING;
+    }
+#if defined(SPARSE_DOT_X86)
+    if (shorter >= 4) return SparseDotKernel::SIMD_BLOCK;
+#endif
+    return SparseDotKernel::MERGE;
+}
+
+void QueryRowContext::load(const RatingMatrix& matrix, int user_idx, bool build_dense) {
+    const int D = matrix.numMovies();
+
+    // Zera apenas as posições escritas pela consulta anterior.
+    if (has_dense_) {
+        for (int movie_idx : movies_) {
+            if (movie_idx < static_cast<int>(dense_units_.size())) dense_units_[movie_idx] = 0;
+            if (movie_idx < static_cast<int>(dense_ratings_.size())) dense_ratings_[movie_idx] = 0.0f;
+        }
+    }
+
+    user_idx_ = user_idx;
+    const uint32_t n = matrix.rowLength(user_idx);
+    const int* movies = rowMovieIndices(matrix, user_idx, movies_);
+    if (movies != movies_.data()) movies_.assign(movies, movies + n);
+    movies_.resize(n);
+
+    has_dense_ = build_dense;
+    if (!build_dense) return;
+    const uint32_t row_begin = matrix.rowBegin(user_idx);
+    if (matrix.isQuantized()) {
+        if (static_cast<int>(dense_units_.size()) != D) dense_units_.assign(D, 0);
+        for (uint32_t i = 0; i < n; ++i) dense_units_[movies_[i]] = matrix.row_rating_units[row_begin + i];
+    } else {
+        if (static_cast<int>(dense_ratings_.size()) != D) dense_ratings_.assign(D, 0.0f);
+        for (uint32_t i = 0; i < n; ++i) dense_ratings_[movies_[i]] = matrix.row_ratings[row_begin + i];
+    }
+}
+
+template <typename RatingT, typename AccT>
+AccT QueryRowContext::dotImpl(const RatingMatrix& matrix, const RatingT* ratings, const RatingT* dense, int other_user) const {
+    const uint32_t len_target = static_cast<uint32_t>(movies_.size());
+    const uint32_t len_other = matrix.rowLength(other_user);
+    if (len_target == 0 || len_other == 0) return 0;
+
+    SparseDotKernel kernel = selectSparseDotKernel(len_target, len_other, has_dense_);
+    // Em linhas comprimidas a decodificação do candidato já custa O(|candidato|): galloping não compensa.
+    if (kernel == SparseDotKernel::GALLOPING && has_dense_ && matrix.isCompressed()) {
+        kernel = SparseDotKernel::DENSE_SCATTER;
+    }
+
+    thread_local std::vector<int> other_scratch;
+    const int* other_movies = rowMovieIndices(matrix, other_user, other_scratch);
+    const RatingT* other_ratings = ratings + matrix.rowBegin(other_user);
+    if (kernel == SparseDotKernel::DENSE_SCATTER) {
+        return sparseDotDense<RatingT, AccT>(dense, other_movies, other_ratings, len_other);
+    }
+    return dispatchSparseDot<RatingT, AccT>(kernel, movies_.data(), ratings + matrix.rowBegin(user_idx_), len_target,
+                                            other_movies, other_ratings, len_other);
+}
+
+float QueryRowContext::dot(const RatingMatrix& matrix, int other_user) const {
+    if (matrix.isQuantized()) {
+        return toRatingScale(dotImpl<uint8_t, uint32_t>(matrix, matrix.row_rating_units.data(), dense_units_.data(), other_user));
+    }
+    return toRatingScale(dotImpl<float, float>(matrix, matrix.row_ratings.data(), dense_ratings_.data(), other_user));
+}
+
+float sparseRowDot(const RatingMatrix& matrix, int user_a, int user_b) {
+    const uint32_t len_a = matrix.rowLength(user_a), len_b = matrix.rowLength(user_b);
+    if (len_a == 0 || len_b == 0) return 0.0f;
+
+    thread_local std::vector<int> scratch_a, scratch_b;
+    const int* movies_a = rowMovieIndices(matrix, user_a, scratch_a);
+    const int* movies_b = rowMovieIndices(matrix, user_b, scratch_b);
+    const SparseDotKernel kernel = selectSparseDotKernel(len_a, len_b, false);
+    if (matrix.isQuantized()) {
+        const uint8_t* units = matrix.row_rating_units.data();
+        return toRatingScale(dispatchSparseDot<uint8_t, uint32_t>(
+            kernel, movies_a, units + matrix.rowBegin(user_a), len_a, movies_b, units + matrix.rowBegin(user_b), len_b));
+    }
+    const float* ratings = matrix.row_ratings.data();
+    return toRatingScale(dispatchSparseDot<float, float>(
+        kernel, movies_a, ratings + matrix.rowBegin(user_a), len_a, movies_b, ratings + matrix.rowBegin(user_b), len_b));
+}